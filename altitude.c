@@ -22,53 +22,286 @@
 #include "driverlib/adc.h"
 #include "driverlib/gpio.h"
 #include "driverlib/sysctl.h"
-#include "driverlib/systick.h"
+#include "driverlib/timer.h"
+#include "driverlib/udma.h"
+#include "inc/hw_adc.h"
 #include "driverlib/interrupt.h"
 #include "utils/ustdlib.h"
 #include "circBufT.h"
+#include "filters.h"
+#include "cic.h"
+#include "ringBuf.h"
 #include "inc/hw_ints.h"
-#include "stdlib.h"
 #include "altitude.h"
+#include "events.h"
+#include "timings.h"
+#include "trace.h"
+
+
+//*****************************************************************************
+// Types
+//*****************************************************************************
+typedef struct {
+    uint32_t time;      // Low 32 bits of the time the block finished, in ticks
+    uint32_t adc;       // Filtered ADC value at the end of the block, in 1/2^ALTITUDE_ADC_FRAC_BITS steps
+} AltitudePoint;
+
+CIRCBUF_DECLARE(RateBuf, AltitudePoint, RATE_WINDOW)
+CIRCBUF_DEFINE(RateBuf, AltitudePoint, RATE_WINDOW)
 
 
 //*****************************************************************************
 // Globals to module
 //*****************************************************************************
-static circBuf_t g_inBuffer;            // Circular buffer of size BUF_SIZE integers (sample values)
 static uint32_t g_landedSample = 0;     // Initial sample for the helicopter 'landed' altitude
-static uint32_t g_ulSampCnt;        // Counter for the interrupts
+static uint32_t g_blockCount = 0;   // Samples written since the last full buffer
+static RateBuf_t g_ratePoints;      // Filtered altitude at the end of each block, for the rate
+static volatile uint32_t g_pointCount = 0;  // Points written to g_ratePoints since start
+static volatile bool g_calibrating = false; // Set while samples are being taken for calibration
+static volatile uint32_t g_calSamples;      // Calibration samples taken so far
+static volatile uint32_t g_calSum;          // Sum of the calibration samples
+static volatile uint64_t g_calSumSquares;   // Sum of the squares of the calibration samples
+static CalibrationStats g_calibration;  // How the last calibration went
+static uint32_t g_sampleRate = SAMPLE_RATE_HZ;  // Samples per second into the filter
+static uint16_t g_recordStorage[RECORD_SIZE];
+static ringBuf_t g_record;          // Raw samples written by the ADC interrupt, read out by serial
+static volatile bool g_recording = false;   // Set while raw samples are being recorded
+#if CIC_RATIO_SHIFT
+static CicDecimator g_cic;          // Brings the ADC samples down to SAMPLE_RATE_HZ for the filter
+#endif
+#if ALTITUDE_DMA
+static uint16_t g_dmaBlocks[2][ADC_DMA_BLOCK_SIZE];     // Ping-pong halves filled by the uDMA
+static uint32_t g_dmaBlockTimes[2];     // Time each half was last filled, in ticks
+static volatile uint8_t g_readyHalves = 0;  // Bit per half filled but not yet filtered
+static volatile uint32_t g_blockOverruns = 0;   // Halves filled again before they were filtered
+
+// The uDMA control table has to be aligned to 1024 bytes
+#if defined(__TI_COMPILER_VERSION__)
+#pragma DATA_ALIGN(g_dmaControlTable, 1024)
+static uint8_t g_dmaControlTable[1024];
+#else
+static uint8_t g_dmaControlTable[1024] __attribute__ ((aligned(1024)));
+#endif
+#endif
 
 
 //*****************************************************************************
-//
-// The interrupt handler for the for SysTick interrupt
-//
+// Adds a raw sample to the calibration set, stopping once it is full.
+//*****************************************************************************
+static void addCalibrationSample(uint32_t sample)
+{
+    g_calSum += sample;
+    g_calSumSquares += sample * sample;
+    g_calSamples++;
+    if (g_calSamples >= CALIBRATION_SAMPLES) {
+        g_calibrating = false;
+    }
+}
+
+
+//*****************************************************************************
+// Takes a raw sample from the ADC. It is decimated down to SAMPLE_RATE_HZ
+// before it reaches the filter, keeping ALTITUDE_ADC_FRAC_BITS of fraction
+// from the averaging, while calibration sees every raw sample.
+//*****************************************************************************
+static void addSample(uint32_t sample)
+{
+    if (g_calibrating) {
+        addCalibrationSample(sample);
+    }
+
+    // Stop at the first sample that does not fit, so the recording has no gaps
+    if (g_recording && !writeRingBuf(&g_record, sample)) {
+        g_recording = false;
+    }
+
+#if CIC_RATIO_SHIFT
+    uint32_t decimated;
+    if (cicSample(&g_cic, sample, &decimated)) {
+        filterSample(decimated);
+    }
+#else
+    filterSample(sample);
+#endif
+}
+
+
+//*****************************************************************************
+// Keeps the filtered altitude at the end of a block, with the time the block
+// finished, so the climb rate can be fitted over the last few blocks. Masked,
+// as the controller may read the points from an interrupt.
+//*****************************************************************************
+static void recordPoint(uint32_t time)
+{
+    AltitudePoint point;
+    point.time = time;
+    point.adc = getFilterOutput();
+
+    bool wasMasked = IntMasterDisable();
+    writeRateBuf(&g_ratePoints, point);
+    g_pointCount++;
+    if (!wasMasked) {
+        IntMasterEnable();
+    }
+}
+
+
+#if ALTITUDE_DMA
+//*****************************************************************************
+// Passes a whole block captured by the uDMA through the decimator and filter.
+// The altitude is updated once per whole block.
+//*****************************************************************************
+static void completeBlock(const uint16_t* block, uint32_t time)
+{
+    uint32_t i = 0;
+    for (i = 0; i < ADC_DMA_BLOCK_SIZE; i++) {
+        addSample(block[i]);
+    }
+    updateFilterOutput();
+    recordPoint(time);
+}
+
+
+//*****************************************************************************
+// Marks a ping-pong half as filled, counting an overrun if the last lot of
+// samples in it was never filtered.
+//*****************************************************************************
+static void markHalfReady(uint8_t half)
+{
+    if (g_readyHalves & (1u << half)) {
+        g_blockOverruns++;
+    }
+    g_readyHalves |= (1u << half);
+    g_dmaBlockTimes[half] = getCurTicks();
+}
+
+
+//*****************************************************************************
+// The handler for the ADC interrupt in uDMA mode, which fires when the uDMA
+// has filled one ping-pong half. The finished half is given straight back
+// to the uDMA, which fills it again once the other half is full, so the
+// EVENT_ADC_BLOCK task has a whole block time to filter it. Nothing is done
+// per sample here.
 //*****************************************************************************
-void
-SysTickIntHandler(void)
+void ADCDMAIntHandler(void)
 {
-    // Initiate an ADC conversion
-    ADCProcessorTrigger(ADC0_BASE, 3);
-    g_ulSampCnt++;
+    TRACE_BEGIN(TRACE_ID_ADC);
+    ADCIntClear(ADC0_BASE, ADC_SEQUENCE);
+
+    if (uDMAChannelModeGet(ADC_DMA_CHANNEL | UDMA_PRI_SELECT) == UDMA_MODE_STOP) {
+        markHalfReady(0);
+        uDMAChannelTransferSet(ADC_DMA_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_PINGPONG,
+                               (void *)(ADC0_BASE + ADC_O_SSFIFO0), g_dmaBlocks[0], ADC_DMA_BLOCK_SIZE);
+    }
+    if (uDMAChannelModeGet(ADC_DMA_CHANNEL | UDMA_ALT_SELECT) == UDMA_MODE_STOP) {
+        markHalfReady(1);
+        uDMAChannelTransferSet(ADC_DMA_CHANNEL | UDMA_ALT_SELECT, UDMA_MODE_PINGPONG,
+                               (void *)(ADC0_BASE + ADC_O_SSFIFO0), g_dmaBlocks[1], ADC_DMA_BLOCK_SIZE);
+    }
+    postEvent(EVENT_ADC_BLOCK);
+
+    TRACE_END(TRACE_ID_ADC);
 }
 
 
 //*****************************************************************************
-// The handler for the ADC conversion complete interrupt.
-// Writes to the circular buffer.
+// Sets up the uDMA to move the sequence FIFO into the ping-pong halves, one
+// burst of ADC_BLOCK_STEPS samples each time the sequence finishes.
+//*****************************************************************************
+static void initADCDMA (void)
+{
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_UDMA);
+    uDMAEnable();
+    uDMAControlBaseSet(g_dmaControlTable);
+
+    uDMAChannelAttributeDisable(ADC_DMA_CHANNEL, UDMA_ATTR_ALTSELECT | UDMA_ATTR_USEBURST |
+                                UDMA_ATTR_HIGH_PRIORITY | UDMA_ATTR_REQMASK);
+    uDMAChannelControlSet(ADC_DMA_CHANNEL | UDMA_PRI_SELECT,
+                          UDMA_SIZE_16 | UDMA_SRC_INC_NONE | UDMA_DST_INC_16 | UDMA_ARB_8);
+    uDMAChannelControlSet(ADC_DMA_CHANNEL | UDMA_ALT_SELECT,
+                          UDMA_SIZE_16 | UDMA_SRC_INC_NONE | UDMA_DST_INC_16 | UDMA_ARB_8);
+    uDMAChannelTransferSet(ADC_DMA_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_PINGPONG,
+                           (void *)(ADC0_BASE + ADC_O_SSFIFO0), g_dmaBlocks[0], ADC_DMA_BLOCK_SIZE);
+    uDMAChannelTransferSet(ADC_DMA_CHANNEL | UDMA_ALT_SELECT, UDMA_MODE_PINGPONG,
+                           (void *)(ADC0_BASE + ADC_O_SSFIFO0), g_dmaBlocks[1], ADC_DMA_BLOCK_SIZE);
+    uDMAChannelEnable(ADC_DMA_CHANNEL);
+
+    // The sequence now asks the uDMA for each block instead of the CPU
+    ADCSequenceDMAEnable(ADC0_BASE, ADC_SEQUENCE);
+}
+#endif
+
+
+//*****************************************************************************
+// The handler for the ADC conversion complete interrupt, which fires once
+// for each block of ADC_BLOCK_STEPS averaged samples.
+// Passes them through the decimator and filter.
 //*****************************************************************************
 void ADCIntHandler(void)
 {
-    uint32_t ulValue;
+    uint32_t samples[ADC_BLOCK_STEPS];
+    int32_t count;
+    int32_t i;
+    TRACE_BEGIN(TRACE_ID_ADC);
 
-    // Get the single sample from ADC0.  ADC_BASE is defined in inc/hw_memmap.h
-    ADCSequenceDataGet(ADC0_BASE, 3, &ulValue);
+    // Get the block from the sequence FIFO.  ADC_BASE is defined in inc/hw_memmap.h
+    count = ADCSequenceDataGet(ADC0_BASE, ADC_SEQUENCE, samples);
 
-    // Place it in the circular buffer (advancing write index)
-    writeCircBuf (&g_inBuffer, ulValue);
+    // Filter them, then update the altitude once for the block
+    for (i = 0; i < count; i++) {
+        addSample(samples[i]);
+    }
+    updateFilterOutput();
+    recordPoint(getCurTicks());
+
+    // Let the kernel know each time the buffer has been refilled
+    g_blockCount += count;
+    if (g_blockCount >= BUF_SIZE * CIC_DECIMATION) {
+        g_blockCount -= BUF_SIZE * CIC_DECIMATION;
+        postEvent(EVENT_ADC_BLOCK);
+    }
 
     // Clean up, clearing the interrupt
-    ADCIntClear(ADC0_BASE, 3);
+    ADCIntClear(ADC0_BASE, ADC_SEQUENCE);
+
+    TRACE_END(TRACE_ID_ADC);
+}
+
+
+//*****************************************************************************
+// Task for EVENT_ADC_BLOCK. With the uDMA, filters the halves it has filled,
+// oldest first. Without it the interrupt has already filtered every sample.
+//*****************************************************************************
+void processAltitudeBlocks(void)
+{
+#if ALTITUDE_DMA
+    static uint8_t next = 0;    // Half the uDMA fills first, as it takes them in turn
+
+    while (g_readyHalves & (1u << next)) {
+        completeBlock(g_dmaBlocks[next], g_dmaBlockTimes[next]);
+
+        bool wasMasked = IntMasterDisable();
+        g_readyHalves &= ~(1u << next);
+        if (!wasMasked) {
+            IntMasterEnable();
+        }
+        next ^= 1;
+    }
+#endif
+}
+
+
+//*****************************************************************************
+// Returns the number of uDMA halves that were filled again before the
+// EVENT_ADC_BLOCK task had filtered them, which lost a block of samples.
+//*****************************************************************************
+uint32_t getAltitudeBlockOverruns(void)
+{
+#if ALTITUDE_DMA
+    return g_blockOverruns;
+#else
+    return 0;
+#endif
 }
 
 
@@ -77,33 +310,57 @@ void ADCIntHandler(void)
 //*****************************************************************************
 void initADC (void)
 {
+    uint32_t step;
+
     // The ADC0 peripheral must be enabled for configuration and use.
     SysCtlPeripheralEnable(SYSCTL_PERIPH_ADC0);
 
-    // Enable sample sequence 3 with a processor signal trigger.  Sequence 3
-    // will do a single sample when the processor sends a signal to start the
-    // conversion.
-    ADCSequenceConfigure(ADC0_BASE, 3, ADC_TRIGGER_PROCESSOR, 0);
-
-    // Configure step 0 on sequence 3.  Sample channel 0 (ADC_CTL_CH0) in
-    // single-ended mode (default) and configure the interrupt flag
-    // (ADC_CTL_IE) to be set when the sample is done.  Tell the ADC logic
-    // that this is the last conversion on sequence 3 (ADC_CTL_END).  Sequence
-    // 3 has only one programmable step.  Sequence 1 and 2 have 4 steps, and
-    // sequence 0 has 8 programmable steps.  Since we are only doing a single
-    // conversion using sequence 3 we will only configure step 0.  For more
-    // on the ADC sequences and steps, refer to the LM3S1968 datasheet.
-    ADCSequenceStepConfigure(ADC0_BASE, 3, 0, ADC_CTL_CH9 | ADC_CTL_IE |
+    // Have the ADC average ADC_OVERSAMPLE conversions into every sample,
+    // so the CPU never sees the raw ones.
+    ADCHardwareOversampleConfigure(ADC0_BASE, ADC_OVERSAMPLE);
+
+    // Enable sample sequence 0 with a timer trigger.  Each time the timer
+    // expires sequence 0 takes a whole block of samples.
+    ADCSequenceConfigure(ADC0_BASE, ADC_SEQUENCE, ADC_TRIGGER_TIMER, 0);
+
+    // Configure every step of sequence 0 to sample channel 9 in single-ended
+    // mode (default).  The interrupt flag (ADC_CTL_IE) is only set after the
+    // last step (ADC_CTL_END), so there is one interrupt per block.
+    for (step = 0; step < ADC_BLOCK_STEPS - 1; step++) {
+        ADCSequenceStepConfigure(ADC0_BASE, ADC_SEQUENCE, step, ADC_CTL_CH9);
+    }
+    ADCSequenceStepConfigure(ADC0_BASE, ADC_SEQUENCE, step, ADC_CTL_CH9 | ADC_CTL_IE |
                              ADC_CTL_END);
 
-    // Since sample sequence 3 is now configured, it must be enabled.
-    ADCSequenceEnable(ADC0_BASE, 3);
+    // Since sample sequence 0 is now configured, it must be enabled.
+    ADCSequenceEnable(ADC0_BASE, ADC_SEQUENCE);
 
-    // Register the interrupt handler
-    ADCIntRegister (ADC0_BASE, 3, ADCIntHandler);
+    // Register the interrupt handler. With the uDMA it only fires when a
+    // ping-pong half is full.
+#if ALTITUDE_DMA
+    initADCDMA();
+    ADCIntRegister (ADC0_BASE, ADC_SEQUENCE, ADCDMAIntHandler);
+#else
+    ADCIntRegister (ADC0_BASE, ADC_SEQUENCE, ADCIntHandler);
+#endif
 
-    // Enable interrupts for ADC0 sequence 3 (clears any outstanding interrupts)
-    ADCIntEnable(ADC0_BASE, 3);
+    // Enable interrupts for ADC0 sequence 0 (clears any outstanding interrupts)
+    ADCIntEnable(ADC0_BASE, ADC_SEQUENCE);
+}
+
+
+//*****************************************************************************
+// Sets up the timer that triggers a block of samples at the given rate in
+// HZ, counted in samples rather than blocks.
+//*****************************************************************************
+static void initADCTimer (uint32_t rate)
+{
+    SysCtlPeripheralEnable(ADC_TIMER_PERIPH);
+    TimerDisable(ADC_TIMER_BASE, TIMER_A);
+    TimerConfigure(ADC_TIMER_BASE, TIMER_CFG_PERIODIC);
+    setAltitudeSampleRate(rate);
+    TimerControlTrigger(ADC_TIMER_BASE, TIMER_A, true);
+    TimerEnable(ADC_TIMER_BASE, TIMER_A);
 }
 
 
@@ -111,58 +368,160 @@ void initADC (void)
 // Initialises everything needed for the altitude module.
 //*****************************************************************************
 void initAltitude(void) {
+    setFilter(ALTITUDE_FILTER);
+    initRateBuf(&g_ratePoints);
+    initRingBuf(&g_record, g_recordStorage, RECORD_SIZE);
+#if CIC_RATIO_SHIFT
+    // Cannot fail, altitude.h checks the settings when it is compiled
+    initCic(&g_cic, CIC_ORDER, CIC_RATIO_SHIFT, ALTITUDE_ADC_FRAC_BITS);
+#endif
     initADC();
-    initCircBuf (&g_inBuffer, BUF_SIZE);
 
-    // Set up the period for the SysTick timer.  The SysTick timer period is
-    // set as a function of the system clock.
-    SysTickPeriodSet(SysCtlClockGet() / SAMPLE_RATE_HZ);
-    //
-    // Register the interrupt handler
-    SysTickIntRegister(SysTickIntHandler);
-    //
-    // Enable interrupt and device
-    SysTickIntEnable();
-    SysTickEnable();
+    // Start sampling
+    initADCTimer(SAMPLE_RATE_HZ);
 }
 
 
 //*****************************************************************************
-// Function to take the mean ADC value and assign to the landed sample variable
+// Changes the rate in HZ the altitude is sampled at, as seen by the filter.
+// The ADC runs CIC_DECIMATION times faster to feed the decimator, and the
+// timer triggers a whole block at a time, so it runs ADC_BLOCK_STEPS times
+// slower.
 //*****************************************************************************
-void takeLandedSample (void)
+void setAltitudeSampleRate(uint32_t rate)
 {
-    g_landedSample = getAltitudeADC();
+    g_sampleRate = rate;
+    TimerLoadSet(ADC_TIMER_BASE, TIMER_A, (SYSTEM_CLOCK_HZ / (rate * CIC_DECIMATION)) * ADC_BLOCK_STEPS - 1);
 }
 
 
 //*****************************************************************************
-// Function to calculate the ADC as a percentage.
+// Finds the landed altitude from the mean of CALIBRATION_SAMPLES raw samples.
+// Finishes as soon as the samples are in, and takes another set if they are
+// noisier than CALIBRATION_MAX_VARIANCE, up to CALIBRATION_ATTEMPTS sets.
+// Needs sampling running and interrupts enabled. Returns false if no set
+// was quiet enough, in which case the last set is used anyway, or if the
+// samples stopped coming for CALIBRATION_TIMEOUT_MS, in which case the last
+// full set is used, if there was one.
+//*****************************************************************************
+bool calibrateLanded (void)
+{
+    uint64_t start = getCurTime();
+    uint32_t deadline = getCurTicks() + MS_TO_TICKS(CALIBRATION_TIMEOUT_MS);
+    uint32_t n = CALIBRATION_SAMPLES;
+    uint32_t mean = 0;
+    uint32_t variance = 0;
+    uint8_t attempts = 0;
+    bool settled = false;
+    bool timedOut = false;
+    bool haveSet = false;
+
+    while (attempts < CALIBRATION_ATTEMPTS && !settled) {
+        // Start a fresh set, which the samples fill as they are filtered
+        attempts++;
+        bool wasMasked = IntMasterDisable();
+        g_calSum = 0;
+        g_calSumSquares = 0;
+        g_calSamples = 0;
+        g_calibrating = true;
+        if (!wasMasked) {
+            IntMasterEnable();
+        }
+        while (g_calibrating && (int32_t) (getCurTicks() - deadline) < 0) {
+            processAltitudeBlocks();
+        }
+
+        // Give up on the set if the deadline passed first
+        wasMasked = IntMasterDisable();
+        timedOut = g_calibrating;
+        g_calibrating = false;
+        if (!wasMasked) {
+            IntMasterEnable();
+        }
+        if (timedOut) {
+            break;
+        }
+
+        // Variance = (n * sum of squares - sum^2) / n^2, kept in 1/100 steps^2
+        mean = (g_calSum + n / 2) / n;
+        variance = (uint32_t) ((((uint64_t) n * g_calSumSquares - (uint64_t) g_calSum * g_calSum) * 100)
+                               / ((uint64_t) n * n));
+        settled = (variance <= CALIBRATION_MAX_VARIANCE);
+        haveSet = true;
+    }
+
+    // Make sure the filter state matches the samples before relying on it
+    bool wasMasked = IntMasterDisable();
+    checkFilter();
+    if (!wasMasked) {
+        IntMasterEnable();
+    }
+
+    if (haveSet) {
+        g_landedSample = mean;
+    }
+    g_calibration.time = (uint32_t) getElapsedTime(start);
+    g_calibration.landed = g_landedSample;
+    g_calibration.variance = variance;
+    g_calibration.attempts = attempts;
+    g_calibration.settled = settled;
+    g_calibration.timedOut = timedOut;
+    return settled;
+}
+
+
+//*****************************************************************************
+// Returns how the last landed calibration went.
+//*****************************************************************************
+CalibrationStats getCalibrationStats(void)
+{
+    return g_calibration;
+}
+
+
+//*****************************************************************************
+// Function to calculate the ADC as a percentage, rounded towards zero.
 //*****************************************************************************
 int32_t adcToPercentage(uint32_t adcValue)
+{
+    return adcToCentiPercent(adcValue) / ALTITUDE_FRAC_SCALE;
+}
+
+
+//*****************************************************************************
+// Calculates an ADC value in 1/2^ALTITUDE_ADC_FRAC_BITS of a step as a fixed
+// point percentage, in units of 1/ALTITUDE_FRAC_SCALE of a percent.
+//*****************************************************************************
+static int32_t fineAdcToCentiPercent(uint32_t fineValue)
 {
     // Calculate the ADC value relative to what it should be when landed
-    int relativeValue = g_landedSample - adcValue;
+    int32_t relativeValue = (int32_t) (g_landedSample << ALTITUDE_ADC_FRAC_BITS) - (int32_t) fineValue;
 
     // Calculate the percentage
-    int percent = ((relativeValue * 100) / (ADC_ONE_VOLT * ALTITUDE_VOLTAGE_RANGE));
-    return percent;
+    return (relativeValue * 100 * ALTITUDE_FRAC_SCALE)
+           / ((ADC_ONE_VOLT * ALTITUDE_VOLTAGE_RANGE) << ALTITUDE_ADC_FRAC_BITS);
 }
 
 
 //*****************************************************************************
-// Returns the current average ADC value of the altitude
+// Function to calculate the ADC as a fixed point percentage, in units of
+// 1/ALTITUDE_FRAC_SCALE of a percent. One ADC step is about 0.08%, so this
+// keeps the resolution the whole percent throws away.
 //*****************************************************************************
-uint32_t getAltitudeADC(void)
+int32_t adcToCentiPercent(uint32_t adcValue)
 {
-    uint32_t sum = 0;
-    uint32_t i = 0;
-    for (i = 0; i < BUF_SIZE; i++) {
-        sum = sum + readCircBuf (&g_inBuffer);
-    }
+    return fineAdcToCentiPercent(adcValue << ALTITUDE_ADC_FRAC_BITS);
+}
 
-    // Calculate and display the rounded mean of the buffer contents
-    return (2 * sum + BUF_SIZE)/ 2 / BUF_SIZE;
+
+//*****************************************************************************
+// Returns the current filtered ADC value of the altitude, as at the end of
+// the last block, rounded to the nearest step. The filter is run as each
+// block comes in, so this costs the same whichever filter is used.
+//*****************************************************************************
+uint32_t getAltitudeADC(void)
+{
+    return (getFilterOutput() + ((1u << ALTITUDE_ADC_FRAC_BITS) >> 1)) >> ALTITUDE_ADC_FRAC_BITS;
 }
 
 
@@ -176,3 +535,127 @@ int32_t getAltitudePercent(void)
     return percent;
 }
 
+
+
+//*****************************************************************************
+// Returns the current altitude as a fixed point percentage of max height, in
+// units of 1/ALTITUDE_FRAC_SCALE of a percent. Used by the controller, while
+// the display and flight states use the whole percent. Taken from the
+// filter output before it is rounded to whole ADC steps, so the fraction
+// the decimator makes is not lost.
+//*****************************************************************************
+int32_t getAltitudeCentiPercent(void)
+{
+    return fineAdcToCentiPercent(getFilterOutput());
+}
+
+
+//*****************************************************************************
+// Returns the climb rate in 1/ALTITUDE_FRAC_SCALE of a percent per second,
+// positive going up. It is the least squares slope of the filtered altitude
+// over the last RATE_WINDOW blocks, so it follows the block timestamps and
+// stays right when the sample rate changes. Only refitted once a new block
+// has come in.
+//*****************************************************************************
+int32_t getAltitudeRate(void)
+{
+    static uint32_t fittedCount = 0;
+    static int32_t rate = 0;
+    AltitudePoint points[RATE_WINDOW];
+    uint32_t count;
+    uint32_t first;
+    uint32_t i;
+
+    // Nothing new since the last fit, so no need to mask or copy
+    if (g_pointCount == fittedCount) {
+        return rate;
+    }
+
+    // Take the points all from the same moment
+    bool wasMasked = IntMasterDisable();
+    count = g_pointCount;
+    copyRateBuf(&g_ratePoints, points);
+    if (!wasMasked) {
+        IntMasterEnable();
+    }
+    fittedCount = count;
+
+    // Before the window has filled, only fit over the points written so far
+    first = (count < RATE_WINDOW) ? (RATE_WINDOW - count) : 0;
+    if (RATE_WINDOW - first < 2) {
+        rate = 0;
+        return rate;
+    }
+
+    // Fit relative to the newest point, in microseconds and the filter's
+    // fractions of an ADC step, so the sums stay well inside 64 bits
+    const AltitudePoint* newest = &points[RATE_WINDOW - 1];
+    int64_t n = RATE_WINDOW - first;
+    int64_t sumT = 0, sumV = 0, sumTT = 0, sumTV = 0;
+    for (i = first; i < RATE_WINDOW; i++) {
+        int64_t t = -(int64_t) TICKS_TO_US(newest->time - points[i].time);
+        int64_t v = (int32_t) (points[i].adc - newest->adc);
+        sumT += t;
+        sumV += v;
+        sumTT += t * t;
+        sumTV += t * v;
+    }
+
+    int64_t denominator = n * sumTT - sumT * sumT;
+    if (denominator == 0) {
+        rate = 0;
+        return rate;
+    }
+
+    // The ADC value falls as the heli rises, so the rate takes its sign the
+    // other way around
+    int64_t finePerSecond = ((n * sumTV - sumT * sumV) * 1000000) / denominator;
+    rate = -(finePerSecond * 100 * ALTITUDE_FRAC_SCALE)
+           / ((ADC_ONE_VOLT * ALTITUDE_VOLTAGE_RANGE) << ALTITUDE_ADC_FRAC_BITS);
+    return rate;
+}
+
+
+//*****************************************************************************
+// Starts recording the raw samples, as they come from the ADC before the
+// decimator, until the recording buffer fills. They can be read out with
+// readAltitudeRecording while it is still being filled. Returns false if
+// the last recording has not all been read yet.
+//*****************************************************************************
+bool startAltitudeRecording(void)
+{
+    if (g_recording || getRingBufFill(&g_record) != 0) {
+        return false;
+    }
+    g_recording = true;
+    return true;
+}
+
+
+//*****************************************************************************
+// Returns true while raw samples are still being recorded.
+//*****************************************************************************
+bool isAltitudeRecording(void)
+{
+    return g_recording;
+}
+
+
+//*****************************************************************************
+// Takes the oldest recorded sample not yet read. Returns false if there is
+// none waiting. The ADC interrupt writes the samples without being masked.
+//*****************************************************************************
+bool readAltitudeRecording(uint16_t* sample)
+{
+    return readRingBuf(&g_record, sample);
+}
+
+
+//*****************************************************************************
+// Returns the rate in HZ raw samples are recorded at, which is the ADC rate
+// ahead of the decimator.
+//*****************************************************************************
+uint32_t getAltitudeRecordRate(void)
+{
+    return g_sampleRate * CIC_DECIMATION;
+}
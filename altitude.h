@@ -15,12 +15,33 @@
 // Includes
 //*****************************************************************************
 #include <stdint.h>
+#include <stdbool.h>
+#include "cic.h"
 
 //*****************************************************************************
 // Constants
 //*****************************************************************************
-#define BUF_SIZE 20                 // Circular buffer size
-#define SAMPLE_RATE_HZ 5000         // Interrupt sampling rate
+#define BUF_SIZE 20                 // Samples per EVENT_ADC_BLOCK without the uDMA
+#define SAMPLE_RATE_HZ 5000         // Sampling rate, in averaged samples per second into the filter
+#define LANDED_SAMPLE_RATE_HZ 50    // Sampling rate while landed, to let the CPU sleep
+#define ADC_BLOCK_STEPS 8           // Samples per interrupt, the depth of sequence 0
+#define ADC_OVERSAMPLE 16           // Conversions the ADC averages into each sample
+#define ADC_SEQUENCE 0
+#define ADC_TIMER_BASE TIMER2_BASE  // Timer that triggers each block
+#define ADC_TIMER_PERIPH SYSCTL_PERIPH_TIMER2
+#ifndef ALTITUDE_DMA
+#define ALTITUDE_DMA 1              // 1 to capture blocks by uDMA, 0 to read each block in the interrupt
+#endif
+#define ADC_DMA_BLOCK_SIZE (32 * CIC_DECIMATION)   // Samples in each ping-pong half, a multiple of ADC_BLOCK_STEPS
+#define ADC_DMA_CHANNEL UDMA_CHANNEL_ADC0
+#define CIC_ORDER 3                 // Stages in the decimator ahead of the filter
+#ifndef CIC_RATIO_SHIFT
+#define CIC_RATIO_SHIFT 2           // ADC runs 2^CIC_RATIO_SHIFT times faster than SAMPLE_RATE_HZ, 0 for no decimator
+#endif
+#define CIC_DECIMATION (1 << CIC_RATIO_SHIFT)
+#define ALTITUDE_ADC_FRAC_BITS CIC_RATIO_SHIFT  // Fraction bits of an ADC step the decimator keeps for the filter
+#define ALTITUDE_FILTER FILTER_BOXCAR   // Filter used for the altitude, from filterTypes
+#define RATE_WINDOW 8               // Filtered points, one per block, the climb rate is fitted over
 #define DISPLAY_PERCENT 0           // Display percentage mode state
 #define DISPLAY_ADC 1               // Display ADC mode state
 #define DISPLAY_OFF 2               // No display mode state
@@ -32,18 +53,67 @@
 #define ALTITUDE_MIN 0              // 0%, etc...
 #define ALTITUDE_INCREMENT 10
 #define ALTITUDE_HOVER 10
+#define ALTITUDE_FRAC_SCALE 100     // Fixed point altitudes are in 1/100 of a percent
+
+#define CALIBRATION_SAMPLES 64      // Samples averaged for the landed altitude
+#define CALIBRATION_MAX_VARIANCE 1600   // Largest variance accepted, in 1/100 of an ADC step squared
+#define CALIBRATION_ATTEMPTS 10     // Sets of samples tried before the last is used anyway
+#define CALIBRATION_TIMEOUT_MS 200  // Longest calibration allowed, in case the ADC stops
+
+#define RECORD_SIZE 1024            // Raw samples recorded at a time, must be a power of two
+#define RECORD_REQUEST_CHAR 'r'     // Sent over serial to ask for a recording
+
+// initCic takes these, so its result need not be checked at run time
+#if CIC_RATIO_SHIFT && (CIC_ORDER < 1 || CIC_ORDER > CIC_MAX_ORDER \
+                        || CIC_INPUT_BITS + CIC_ORDER * CIC_RATIO_SHIFT > CIC_REGISTER_BITS)
+#error "CIC_ORDER and CIC_RATIO_SHIFT are outside what initCic takes"
+#endif
+
+// The filter takes 16 bit samples
+#if CIC_INPUT_BITS + ALTITUDE_ADC_FRAC_BITS > 16
+#error "ALTITUDE_ADC_FRAC_BITS leaves the decimated samples too wide for the filter"
+#endif
+
+// Without the uDMA the faster ADC would interrupt 2^CIC_RATIO_SHIFT times as
+// often, giving back most of what the interrupt per block saved
+#if CIC_RATIO_SHIFT && !ALTITUDE_DMA
+#error "The decimator needs ALTITUDE_DMA, set CIC_RATIO_SHIFT to 0 to read each block in the interrupt"
+#endif
+
+//*****************************************************************************
+// Types
+//*****************************************************************************
+typedef struct {
+    uint32_t time;          // Ticks from the start of calibration until it finished
+    uint32_t landed;        // ADC value taken as the landed altitude
+    uint32_t variance;      // Variance of the samples used, in 1/100 of an ADC step squared
+    uint8_t attempts;       // Sets of samples taken, including the one used
+    bool settled;           // False if every set was too noisy, or it timed out
+    bool timedOut;          // True if the samples stopped coming before a set was full
+} CalibrationStats;
 
 //*****************************************************************************
 // Functions
 //*****************************************************************************
 
-void SysTickIntHandler(void);
 void ADCIntHandler(void);
+void ADCDMAIntHandler(void);
+void processAltitudeBlocks(void);
+uint32_t getAltitudeBlockOverruns(void);
 void initADC (void);
 void initAltitude(void);
-void takeLandedSample (void);
+void setAltitudeSampleRate(uint32_t rate);
+bool calibrateLanded (void);
+CalibrationStats getCalibrationStats(void);
 int32_t adcToPercentage(uint32_t adcValue);
+int32_t adcToCentiPercent(uint32_t adcValue);
 uint32_t getAltitudeADC(void);
 int32_t getAltitudePercent(void);
+int32_t getAltitudeCentiPercent(void);
+int32_t getAltitudeRate(void);
+bool startAltitudeRecording(void);
+bool isAltitudeRecording(void);
+bool readAltitudeRecording(uint16_t* sample);
+uint32_t getAltitudeRecordRate(void);
 
 #endif /*ALTITUDE_H_*/
@@ -29,6 +29,9 @@
 #include "driverlib/sysctl.h"
 #include "driverlib/debug.h"
 #include "inc/tm4c123gh6pm.h"  // Board specific defines (for PF0)
+#include "inc/hw_ints.h"
+#include "driverlib/interrupt.h"
+#include "events.h"
 
 
 // *******************************************************
@@ -38,6 +41,7 @@ static bool but_state[NUM_BUTS];	// Corresponds to the electrical state
 static uint8_t but_count[NUM_BUTS];
 static bool but_flag[NUM_BUTS];
 static bool but_normal[NUM_BUTS];   // Corresponds to the electrical state
+static uint32_t but_last_edge[NUM_BUTS];	// Tick of the last accepted change
 
 
 //*****************************************************************************
@@ -95,10 +99,78 @@ initButtons (void) {
 		but_state[i] = but_normal[i];
 		but_count[i] = 0;
 		but_flag[i] = false;
+		but_last_edge[i] = 0;
 	}
 }
 
 
+//*****************************************************************************
+// Reads the pins of all the buttons; true means HIGH, false means LOW.
+//*****************************************************************************
+static void
+readButtons (bool but_value[]) {
+	but_value[UP] = (GPIOPinRead (UP_BUT_PORT_BASE, UP_BUT_PIN) == UP_BUT_PIN);
+	but_value[DOWN] = (GPIOPinRead (DOWN_BUT_PORT_BASE, DOWN_BUT_PIN) == DOWN_BUT_PIN);
+	but_value[LEFT] = (GPIOPinRead (LEFT_BUT_PORT_BASE, LEFT_BUT_PIN) == LEFT_BUT_PIN);
+	but_value[RIGHT] = (GPIOPinRead (RIGHT_BUT_PORT_BASE, RIGHT_BUT_PIN) == RIGHT_BUT_PIN);
+	but_value[RESET] = (GPIOPinRead (RESET_BUT_PORT_BASE, RESET_BUT_PIN) == RESET_BUT_PIN);
+}
+
+
+//*****************************************************************************
+// Enables both-edge interrupts on the UP, DOWN, LEFT and RIGHT buttons.
+// RESET has its own interrupt in reset.c.
+//*****************************************************************************
+void
+enableButtonInterrupts (void) {
+	GPIOIntTypeSet (UP_BUT_PORT_BASE, UP_BUT_PIN, GPIO_BOTH_EDGES);
+	GPIOIntTypeSet (DOWN_BUT_PORT_BASE, DOWN_BUT_PIN, GPIO_BOTH_EDGES);
+	GPIOIntTypeSet (LEFT_BUT_PORT_BASE, LEFT_BUT_PIN, GPIO_BOTH_EDGES);
+	GPIOIntTypeSet (RIGHT_BUT_PORT_BASE, RIGHT_BUT_PIN, GPIO_BOTH_EDGES);
+
+	GPIOIntRegister (UP_BUT_PORT_BASE, buttonIntHandler);
+	GPIOIntRegister (DOWN_BUT_PORT_BASE, buttonIntHandler);
+	GPIOIntRegister (LEFT_BUT_PORT_BASE, buttonIntHandler);   // Also RIGHT, on the same port
+	IntPrioritySet (INT_GPIOE, BUT_INT_PRIORITY);
+	IntPrioritySet (INT_GPIOD, BUT_INT_PRIORITY);
+	IntPrioritySet (INT_GPIOF, BUT_INT_PRIORITY);
+
+	GPIOIntEnable (UP_BUT_PORT_BASE, UP_BUT_PIN);
+	GPIOIntEnable (DOWN_BUT_PORT_BASE, DOWN_BUT_PIN);
+	GPIOIntEnable (LEFT_BUT_PORT_BASE, LEFT_BUT_PIN | RIGHT_BUT_PIN);
+}
+
+
+//*****************************************************************************
+// Interrupt handler for all the button ports. Accepts a change in any button
+// straight away unless it is within the lockout of the last accepted change.
+//*****************************************************************************
+void
+buttonIntHandler (void) {
+	bool but_value[NUM_BUTS];
+	uint32_t now = getCurTicks();
+	int i;
+
+	GPIOIntClear (UP_BUT_PORT_BASE, UP_BUT_PIN);
+	GPIOIntClear (DOWN_BUT_PORT_BASE, DOWN_BUT_PIN);
+	GPIOIntClear (LEFT_BUT_PORT_BASE, LEFT_BUT_PIN | RIGHT_BUT_PIN);
+
+	readButtons (but_value);
+	for (i = 0; i < RESET; i++)
+	{
+		if (but_value[i] != but_state[i] && (now - but_last_edge[i]) >= BUT_LOCKOUT_TICKS)
+		{
+			but_state[i] = but_value[i];
+			but_flag[i] = true;
+			but_count[i] = 0;
+			but_last_edge[i] = now;
+		}
+	}
+
+	postEvent (EVENT_BUTTON_EDGE);
+}
+
+
 //*****************************************************************************
 // Function designed to be called regularly. It polls all
 // buttons once and updates variables associated with the buttons if
@@ -114,29 +186,32 @@ updateButtons (void) {
 	bool but_value[NUM_BUTS];
 	int i;
 
+	// The button interrupt changes the same state, so keep it out
+	bool wasMasked = IntMasterDisable ();
+
 	// Read the pins; true means HIGH, false means LOW
-	but_value[UP] = (GPIOPinRead (UP_BUT_PORT_BASE, UP_BUT_PIN) == UP_BUT_PIN);
-	but_value[DOWN] = (GPIOPinRead (DOWN_BUT_PORT_BASE, DOWN_BUT_PIN) == DOWN_BUT_PIN);
-	but_value[LEFT] = (GPIOPinRead (LEFT_BUT_PORT_BASE, LEFT_BUT_PIN) == LEFT_BUT_PIN);
-	but_value[RIGHT] = (GPIOPinRead (RIGHT_BUT_PORT_BASE, RIGHT_BUT_PIN) == RIGHT_BUT_PIN);
-	but_value[RESET] = (GPIOPinRead (RESET_BUT_PORT_BASE, RESET_BUT_PIN) == RESET_BUT_PIN);
+	readButtons (but_value);
 
 	// Iterate through the buttons, updating button variables as required
 	for (i = 0; i < NUM_BUTS; i++)
 	{
-        if (but_value[i] != but_state[i])
-        {
-        	but_count[i]++;
-        	if (but_count[i] >= NUM_BUT_POLLS)
-        	{
-        		but_state[i] = but_value[i];
-        		but_flag[i] = true;	   // Reset by call to checkButton()
-        		but_count[i] = 0;
-        	}
-        }
-        else
-        	but_count[i] = 0;
+		if (but_value[i] != but_state[i])
+		{
+			but_count[i]++;
+			if (but_count[i] >= NUM_BUT_POLLS)
+			{
+				but_state[i] = but_value[i];
+				but_flag[i] = true;	   // Reset by call to checkButton()
+				but_count[i] = 0;
+				but_last_edge[i] = getCurTicks();
+			}
+		}
+		else
+			but_count[i] = 0;
 	}
+
+	if (!wasMasked)
+		IntMasterEnable ();
 }
 
 
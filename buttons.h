@@ -15,6 +15,7 @@
 //*****************************************************************************
 #include <stdint.h>
 #include <stdbool.h>
+#include "timings.h"
 
 //*****************************************************************************
 // Constants
@@ -49,6 +50,8 @@ enum butStates {RELEASED = 0, PUSHED, NO_CHANGE};
 
 
 #define NUM_BUT_POLLS 3
+#define BUT_LOCKOUT_TICKS MS_TO_TICKS(20)          // 20 ms between accepted edges
+#define BUT_INT_PRIORITY 0x40                       // Below the sensor and control interrupts
 // Debounce algorithm: A state machine is associated with each button.
 // A state change occurs only after NUM_BUT_POLLS consecutive polls have
 // read the pin in the opposite condition, before the state changes and
@@ -66,6 +69,18 @@ void initButtons (void);
 // a SysTick interrupt.
 void updateButtons (void);
 
+// *******************************************************
+// enableButtonInterrupts: Enables edge interrupts on the UP, DOWN, LEFT
+// and RIGHT buttons. Each accepted edge updates the button state at once
+// and posts EVENT_BUTTON_EDGE. Bounce is handled by ignoring further
+// edges for BUT_LOCKOUT_TICKS, and updateButtons() still corrects the
+// state if the pin settles differently during the lockout.
+void enableButtonInterrupts (void);
+
+// *******************************************************
+// buttonIntHandler: Interrupt handler for the button edges.
+void buttonIntHandler (void);
+
 // *******************************************************
 // checkButton: Function returns the new button state if the button state
 // (PUSHED or RELEASED) has changed since the last call, otherwise returns
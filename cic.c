@@ -0,0 +1,96 @@
+// *******************************************************
+//
+// cic.c
+//
+// Cascaded integrator-comb decimator. Averages a fast
+// stream of samples down to a slower one, with only adds
+// and subtracts: order adds for every sample in, and
+// order subtracts for every sample out. The gain of
+// (2^ratioShift)^order is taken back out with a rounded
+// shift, less any fraction bits asked for, so samples come
+// out in the same units they went in, or in 1/2^fracBits
+// of them. Averaging 2^ratioShift samples makes up to
+// ratioShift bits more resolution, which the fraction bits
+// keep. The sums are left to wrap, which the combs undo,
+// so long as the whole gain fits in the registers.
+//
+// The response is sinc^order, with nulls at every multiple
+// of the output rate, so noise that would alias onto the
+// slower stream is mostly taken out.
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include "cic.h"
+
+
+//*****************************************************************************
+// Sets up the decimator with the given number of stages and decimation
+// ratio of 2^ratioShift, keeping fracBits fraction bits in the output, and
+// clears it. Returns false, leaving it unchanged, if there are too many
+// stages, the gain would overflow the registers, or there are more fraction
+// bits than the gain has.
+//*****************************************************************************
+bool initCic(CicDecimator* cic, uint8_t order, uint8_t ratioShift, uint8_t fracBits)
+{
+    uint8_t stage;
+
+    if (order == 0 || order > CIC_MAX_ORDER
+        || CIC_INPUT_BITS + order * ratioShift > CIC_REGISTER_BITS
+        || fracBits > order * ratioShift) {
+        return false;
+    }
+
+    cic->order = order;
+    cic->ratioShift = ratioShift;
+    cic->fracBits = fracBits;
+    cic->phase = 0;
+    for (stage = 0; stage < CIC_MAX_ORDER; stage++) {
+        cic->integrators[stage] = 0;
+        cic->combs[stage] = 0;
+    }
+    return true;
+}
+
+
+//*****************************************************************************
+// Puts a sample through the integrators. Every 2^ratioShift samples the
+// combs are run too, the result is put in output and true is returned.
+// Otherwise returns false and leaves output alone.
+//*****************************************************************************
+bool cicSample(CicDecimator* cic, uint32_t sample, uint32_t* output)
+{
+    uint32_t value = sample;
+    uint8_t stage;
+
+    for (stage = 0; stage < cic->order; stage++) {
+        cic->integrators[stage] += value;
+        value = cic->integrators[stage];
+    }
+
+    cic->phase++;
+    if (cic->phase < (1u << cic->ratioShift)) {
+        return false;
+    }
+    cic->phase = 0;
+
+    for (stage = 0; stage < cic->order; stage++) {
+        uint32_t input = value;
+        value -= cic->combs[stage];
+        cic->combs[stage] = input;
+    }
+
+    // Take the gain back out, bar the fraction bits, rounding to the nearest
+    uint8_t gainShift = cic->order * cic->ratioShift - cic->fracBits;
+    if (gainShift > 0) {
+        value = (value + (1u << (gainShift - 1))) >> gainShift;
+    }
+    *output = value;
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef CIC_H_
+#define CIC_H_
+
+// *******************************************************
+//
+// cic.h
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include <stdint.h>
+#include <stdbool.h>
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#define CIC_MAX_ORDER 4         // Most integrator and comb stages a decimator can have
+#define CIC_INPUT_BITS 12       // Width of the samples put in, the ADC resolution
+#define CIC_REGISTER_BITS 32    // Width of the stage registers
+
+//*****************************************************************************
+// Decimator state. Takes 2^ratioShift samples for each one it puts out,
+// through order integrators at the input rate and order combs (with a
+// differential delay of one) at the output rate. The output keeps fracBits
+// of the gain as fraction bits.
+//*****************************************************************************
+typedef struct {
+    uint32_t integrators[CIC_MAX_ORDER];    // Integrator sums, left to wrap
+    uint32_t combs[CIC_MAX_ORDER];          // Input to each comb at the last output
+    uint8_t order;                          // Stages in use
+    uint8_t ratioShift;                     // Decimation ratio is 1 << ratioShift
+    uint8_t fracBits;                       // Fraction bits kept in the output
+    uint32_t phase;                         // Samples in since the last output
+} CicDecimator;
+
+//*****************************************************************************
+// Function declarations
+//*****************************************************************************
+bool initCic(CicDecimator* cic, uint8_t order, uint8_t ratioShift, uint8_t fracBits);
+bool cicSample(CicDecimator* cic, uint32_t sample, uint32_t* output);
+
+#endif /* CIC_H_ */
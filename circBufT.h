@@ -2,36 +2,185 @@
 #define CIRCBUFT_H_
 
 // *******************************************************
-// 
+//
 // circBufT.h
 //
+// Macros that generate circular buffers with static
+// storage, for any entry type and size. The header part
+// of a buffer is made with CIRCBUF_DECLARE, and its
+// functions with CIRCBUF_DEFINE in one source file. For
+// example, for a buffer of 64 samples named SampleBuf:
+//
+//     CIRCBUF_DECLARE(SampleBuf, uint16_t, 64)
+//     CIRCBUF_DEFINE(SampleBuf, uint16_t, 64)
+//
+//     static SampleBuf_t g_samples;
+//     initSampleBuf(&g_samples);
+//     writeSampleBuf(&g_samples, sample);
+//
+// The CIRCBUF_SUM_ versions also keep a running sum of
+// the entries, for integer entry types only.
+//
+// snapshotSampleBuf gives the contents in place, oldest
+// first, as up to two spans, and copySampleBuf copies them
+// out. Neither moves the read index.
+//
 // P.J. Bones UCECE, modified by Tom Rizzi, Euan Robinson, Satwik Meravanage
 // Last modified: 21 May 2021
-// 
+//
 // *******************************************************
 
 //*****************************************************************************
 // Includes
 //*****************************************************************************
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 
-// *******************************************************
-// Buffer structure
-typedef struct {
-	uint32_t size;		// Number of entries in buffer
-	uint32_t windex;	// index for writing, mod(size)
-	uint32_t rindex;	// index for reading, mod(size)
-	uint32_t *data;		// pointer to the data
-} circBuf_t;
+//*****************************************************************************
+// Snapshot spans, used by both kinds of buffer
+//*****************************************************************************
+#define CIRCBUF_SPAN_DECLARE(name, type) \
+	typedef struct { \
+		const type *first;	/* oldest entries */ \
+		uint32_t firstLen; \
+		const type *second;	/* newest entries, carrying on from first */ \
+		uint32_t secondLen; \
+	} name##Span_t; \
+	name##Span_t snapshot##name (const name##_t *buffer); \
+	void copy##name (const name##_t *buffer, type *out);
+
+#define CIRCBUF_SPAN_DEFINE(name, type, size) \
+	/* Return the entries, oldest first, as two spans of the buffer itself. */ \
+	/* The writer may still change them while they are used, so mask its */ \
+	/* interrupt if they must all be from the same moment. */ \
+	name##Span_t snapshot##name (const name##_t *buffer) \
+	{ \
+		name##Span_t span; \
+		uint32_t windex = buffer->windex; \
+		span.first = &buffer->data[windex]; \
+		span.firstLen = (size) - windex; \
+		span.second = &buffer->data[0]; \
+		span.secondLen = windex; \
+		return span; \
+	} \
+	/* Copy all size entries into out, oldest first. */ \
+	void copy##name (const name##_t *buffer, type *out) \
+	{ \
+		name##Span_t span = snapshot##name(buffer); \
+		memcpy(out, span.first, span.firstLen * sizeof(type)); \
+		memcpy(out + span.firstLen, span.second, span.secondLen * sizeof(type)); \
+	}
 
-// *******************************************************
 
 //*****************************************************************************
-// Function declarations
+// Buffer structure, function declarations and definitions
 //*****************************************************************************
-uint32_t *initCircBuf (circBuf_t *buffer, uint32_t size);
-void writeCircBuf (circBuf_t *buffer, uint32_t entry);
-uint32_t readCircBuf (circBuf_t *buffer);
-void freeCircBuf (circBuf_t *buffer);
+#define CIRCBUF_DECLARE(name, type, size) \
+	typedef struct { \
+		uint32_t windex;	/* index for writing, mod(size) */ \
+		uint32_t rindex;	/* index for reading, mod(size) */ \
+		type data[size];	/* the entries */ \
+	} name##_t; \
+	void init##name (name##_t *buffer); \
+	void write##name (name##_t *buffer, type entry); \
+	type read##name (name##_t *buffer); \
+	CIRCBUF_SPAN_DECLARE(name, type)
+
+#define CIRCBUF_SUM_DECLARE(name, type, size) \
+	typedef struct { \
+		uint32_t windex;	/* index for writing, mod(size) */ \
+		uint32_t rindex;	/* index for reading, mod(size) */ \
+		volatile uint32_t sum;	/* sum of every entry, kept up to date by write */ \
+		type data[size];	/* the entries */ \
+	} name##_t; \
+	void init##name (name##_t *buffer); \
+	void write##name (name##_t *buffer, type entry); \
+	type read##name (name##_t *buffer); \
+	uint32_t get##name##Sum (name##_t *buffer); \
+	bool check##name##Sum (name##_t *buffer); \
+	CIRCBUF_SPAN_DECLARE(name, type)
+
+// Advance an index, modulo (buffer size).
+#define CIRCBUF_ADVANCE(index, size) \
+	(index)++; \
+	if ((index) >= (size)) \
+		(index) = 0;
+
+#define CIRCBUF_DEFINE(name, type, size) \
+	/* Reset both indices and clear the contents. */ \
+	void init##name (name##_t *buffer) \
+	{ \
+		static const type empty; \
+		uint32_t i; \
+		buffer->windex = 0; \
+		buffer->rindex = 0; \
+		for (i = 0; i < (size); i++) \
+			buffer->data[i] = empty; \
+	} \
+	/* Insert entry at the current windex location, advance windex. */ \
+	void write##name (name##_t *buffer, type entry) \
+	{ \
+		buffer->data[buffer->windex] = entry; \
+		CIRCBUF_ADVANCE(buffer->windex, size) \
+	} \
+	/* Return entry at the current rindex location, advance rindex. */ \
+	/* Does not check if reading has advanced ahead of writing. */ \
+	type read##name (name##_t *buffer) \
+	{ \
+		type entry = buffer->data[buffer->rindex]; \
+		CIRCBUF_ADVANCE(buffer->rindex, size) \
+		return entry; \
+	} \
+	CIRCBUF_SPAN_DEFINE(name, type, size)
+
+#define CIRCBUF_SUM_DEFINE(name, type, size) \
+	/* Reset both indices and the sum, and clear the contents. */ \
+	void init##name (name##_t *buffer) \
+	{ \
+		uint32_t i; \
+		buffer->windex = 0; \
+		buffer->rindex = 0; \
+		buffer->sum = 0; \
+		for (i = 0; i < (size); i++) \
+			buffer->data[i] = 0; \
+	} \
+	/* Insert entry at the current windex location, advance windex. */ \
+	/* The entry replaces the oldest, so the sum changes by their difference. */ \
+	void write##name (name##_t *buffer, type entry) \
+	{ \
+		buffer->sum += (uint32_t) entry - buffer->data[buffer->windex]; \
+		buffer->data[buffer->windex] = entry; \
+		CIRCBUF_ADVANCE(buffer->windex, size) \
+	} \
+	/* Return entry at the current rindex location, advance rindex. */ \
+	/* Does not check if reading has advanced ahead of writing. */ \
+	type read##name (name##_t *buffer) \
+	{ \
+		type entry = buffer->data[buffer->rindex]; \
+		CIRCBUF_ADVANCE(buffer->rindex, size) \
+		return entry; \
+	} \
+	/* Return the sum of every entry. A single read, so safe while an */ \
+	/* interrupt is writing. */ \
+	uint32_t get##name##Sum (name##_t *buffer) \
+	{ \
+		return buffer->sum; \
+	} \
+	/* Check the running sum against the entries, and correct it if it */ \
+	/* has drifted. Returns true if it matched. Must not be called while */ \
+	/* the buffer is being written. */ \
+	bool check##name##Sum (name##_t *buffer) \
+	{ \
+		uint32_t sum = 0; \
+		uint32_t i; \
+		for (i = 0; i < (size); i++) \
+			sum += buffer->data[i]; \
+		if (sum == buffer->sum) \
+			return true; \
+		buffer->sum = sum; \
+		return false; \
+	} \
+	CIRCBUF_SPAN_DEFINE(name, type, size)
 
 #endif /*CIRCBUFT_H_*/
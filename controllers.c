@@ -24,7 +24,8 @@
 // Defines
 //*****************************************************************************
 #define GAIN_SCALE 1000         // Scales gains to allow calculation with integers only
-#define TIME_SCALE 200000       // Scales time from clock ticks so that each 1 is 0.01s
+#define TIME_SCALE (SYSTEM_CLOCK_HZ / 100)  // Scales time from clock ticks so that each 1 is 0.01s
+#define RATE_SCALE 1000         // Divides the per second climb rate, so the derivative gain acts on 1/1000 s of climb
 
 // GAINS FOR REAL HELI
 #define ALTITUDE_PROPORTIONAL_GAIN 400
@@ -55,8 +56,8 @@
 //*****************************************************************************
 // Globals to module
 //*****************************************************************************
-static int64_t tailErrorIntegral;           // Accumulated error integral for yaw
-static int64_t mainErrorIntegral;           // Accumulated error integral for main
+static int64_t tailErrorIntegral;           // Accumulated error integral for yaw, in error ticks
+static int64_t mainErrorIntegral;           // Accumulated error integral for main, in error ticks
 static int32_t tailError = 0;
 static int32_t mainError = 0;
 static int32_t prevTailError = 0;
@@ -73,7 +74,7 @@ int32_t getDeltaYawError(void)
 
 
 //*****************************************************************************
-// Returns change in main error
+// Returns change in main error, in 1/ALTITUDE_FRAC_SCALE of a percent
 //*****************************************************************************
 int32_t getDeltaAltitudeError(void)
 {
@@ -88,41 +89,55 @@ int32_t getDeltaAltitudeError(void)
 uint32_t runYawControl(uint32_t actualDegrees, uint32_t desiredDegrees, uint64_t deltaTime)
 {
     tailError = getYawError(actualDegrees, desiredDegrees);
-    uint32_t control = runControl(&tailErrorIntegral, tailError, prevTailError, deltaTime, YAW_PROPORTIONAL_GAIN,
-                                  YAW_INTEGRAL_GAIN, YAW_DERIVATIVE_GAIN, YAW_CONTROL_BIAS);
+    uint32_t control = runControl(&tailErrorIntegral, tailError, tailError - prevTailError, 1, deltaTime,
+                                  YAW_PROPORTIONAL_GAIN, YAW_INTEGRAL_GAIN, YAW_DERIVATIVE_GAIN, YAW_CONTROL_BIAS, 1);
     prevTailError = tailError;
     return control;
 }
 
 
 //*****************************************************************************
-// Takes the height in degrees, and performs an iteration of the height controller.
-// Returns the new duty cycle to use for the main rotor.
+// Takes the height in fixed point percent (1/ALTITUDE_FRAC_SCALE of a percent),
+// and performs an iteration of the height controller. The gains stay in terms
+// of whole percent. Returns the new duty cycle to use for the main rotor.
+// The derivative is taken on the measured climb rate (fixed point percent per
+// second) rather than the change in error, so it is smoother and does not
+// kick when the desired height steps. The rate goes in whole, scaled down
+// by RATE_SCALE with the gain, so it is not rounded to the climb over one
+// period and the term is the same at the landed control rate.
 //*****************************************************************************
-uint32_t runAltitudeControl(int32_t actualAltitude, int32_t desiredAltitude, uint64_t deltaTime)
+uint32_t runAltitudeControl(int32_t actualAltitude, int32_t desiredAltitude, int32_t altitudeRate,
+                            uint64_t deltaTime)
 {
     mainError = getAltitudeError(actualAltitude, desiredAltitude);
-    uint32_t control = runControl(&mainErrorIntegral, mainError, prevMainError, deltaTime, ALTITUDE_PROPORTIONAL_GAIN,
-                                 ALTITUDE_INTEGRAL_GAIN, ALTITUDE_DERIVATIVE_GAIN, ALTITUDE_CONTROL_BIAS);
+    uint32_t control = runControl(&mainErrorIntegral, mainError, -altitudeRate, RATE_SCALE, deltaTime,
+                                 ALTITUDE_PROPORTIONAL_GAIN, ALTITUDE_INTEGRAL_GAIN, ALTITUDE_DERIVATIVE_GAIN,
+                                 ALTITUDE_CONTROL_BIAS, ALTITUDE_FRAC_SCALE);
     prevMainError = mainError;
     return control;
 }
 
 
 //*****************************************************************************
-// Runs a generic PI control loop.
+// Runs a generic PI control loop. The error is in units of 1/errorScale, so
+// a finer error can be used without changing the gains. The derivative term
+// uses errorChange / changeScale, the change in error over this iteration
+// with a scale of 1, or a rate of change per second with the fraction of a
+// second it is scaled down to.
 //*****************************************************************************
-uint32_t runControl(int64_t* accumulatedError, int32_t error, int32_t prevError, int64_t deltaTime,
-                    int32_t pGain, int32_t iGain, uint32_t dGain, int32_t bias)
+uint32_t runControl(int64_t* accumulatedError, int32_t error, int32_t errorChange, int32_t changeScale,
+                    int64_t deltaTime, int32_t pGain, int32_t iGain, uint32_t dGain, int32_t bias,
+                    int32_t errorScale)
 {
-    // Updated the accumulated integral error
-    *accumulatedError = (*accumulatedError) + ((error * deltaTime) / TIME_SCALE);
+    // Update the accumulated integral error, kept in error ticks so small
+    // errors over a short period are not rounded away
+    *accumulatedError = (*accumulatedError) + (error * deltaTime);
 
     // Calculate the controls
-    int64_t pControl = pGain * error;
-    int64_t iControl = iGain * (*accumulatedError);
-    int64_t dControl = dGain * (error - prevError);
-    int64_t PWM = ((pControl + iControl + dControl) / GAIN_SCALE) + bias;
+    int64_t pControl = (int64_t)pGain * error;
+    int64_t iControl = (iGain * (*accumulatedError)) / TIME_SCALE;
+    int64_t dControl = ((int64_t)dGain * errorChange) / changeScale;
+    int64_t PWM = ((pControl + iControl + dControl) / ((int64_t)GAIN_SCALE * errorScale)) + bias;
 
     // Check the control isn't going out of bounds
     if (PWM > PWM_MAX_DUTY) {
@@ -32,7 +32,9 @@ void pollControls() {
 //*****************************************************************************
 void initControls() {
     initButtons();
+    enableButtonInterrupts();
     initSlider();
+    enableSliderInterrupt();
 }
 
 
@@ -25,6 +25,7 @@
 #include "utils/ustdlib.h"
 #include "stdlib.h"
 #include "display.h"
+#include "kernel.h"
 
 
 //*****************************************************************************
@@ -94,16 +95,34 @@ void displayTailDuty(uint32_t tailDuty)
 
 
 //*****************************************************************************
-// Updates display with helicopter metrics
+// Updates display with helicopter metrics. Runs as a kernel coroutine,
+// drawing one line per pass. The values are copied on the first call so
+// every line is from the same moment; arguments passed while resuming are
+// ignored.
 //*****************************************************************************
 void
 updateDisplay(int32_t altitude, uint32_t yaw, uint32_t mainDuty, uint32_t tailDuty)
 {
-    // Draw title
-    displayYaw(yaw);
-    displayAltitude(altitude);
-    displayMainDuty(mainDuty);
-    displayTailDuty(tailDuty);
+    static TaskState task;
+    static int32_t shownAltitude;
+    static uint32_t shownYaw, shownMainDuty, shownTailDuty;
+
+    TASK_BEGIN(&task);
+
+    shownAltitude = altitude;
+    shownYaw = yaw;
+    shownMainDuty = mainDuty;
+    shownTailDuty = tailDuty;
+
+    displayYaw(shownYaw);
+    TASK_YIELD(&task);
+    displayAltitude(shownAltitude);
+    TASK_YIELD(&task);
+    displayMainDuty(shownMainDuty);
+    TASK_YIELD(&task);
+    displayTailDuty(shownTailDuty);
+
+    TASK_END(&task);
 }
 
 
@@ -0,0 +1,71 @@
+// *******************************************************
+//
+// events.c
+//
+// A lock-free queue of events posted by interrupts and
+// taken by the kernel. Each event has a post count written
+// only by the interrupt that posts it, and a take count
+// written only by the kernel, so neither side needs to
+// disable interrupts. An event must only be posted from
+// one interrupt priority level.
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include "events.h"
+
+
+//*****************************************************************************
+// Globals to module
+//*****************************************************************************
+static volatile uint32_t g_posted[NUM_EVENTS];  // Times each event was posted
+static uint32_t g_taken[NUM_EVENTS];            // Post count when last taken
+
+
+//*****************************************************************************
+// Posts an event. Safe to call from an interrupt.
+//*****************************************************************************
+void postEvent(uint8_t event)
+{
+    g_posted[event]++;
+}
+
+
+//*****************************************************************************
+// Returns true if any event has been posted since the last take.
+//*****************************************************************************
+bool anyEventPending(void)
+{
+    int i = 0;
+    for (i = 0; i < NUM_EVENTS; i++) {
+        if (g_posted[i] != g_taken[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+//*****************************************************************************
+// Takes every pending event, returning them as a mask of EVENT_BIT values.
+// Several posts of the same event since the last take are merged into one.
+//*****************************************************************************
+uint32_t takeEvents(void)
+{
+    uint32_t events = 0;
+    int i = 0;
+    for (i = 0; i < NUM_EVENTS; i++) {
+        uint32_t posted = g_posted[i];
+        if (posted != g_taken[i]) {
+            g_taken[i] = posted;
+            events |= EVENT_BIT(i);
+        }
+    }
+    return events;
+}
@@ -0,0 +1,41 @@
+#ifndef EVENTS_H_
+#define EVENTS_H_
+
+// *******************************************************
+//
+// events.h
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//*****************************************************************************
+// Enumeration of events that interrupts can post to the kernel
+//*****************************************************************************
+enum kernelEvents {
+    EVENT_BUTTON_EDGE = 0,  // A button pin changed state.
+    EVENT_YAW_REF_FOUND,    // The yaw reference was passed.
+    EVENT_ADC_BLOCK,        // A full buffer of altitude samples is ready.
+    EVENT_SLIDER_EDGE,      // The slider switch changed position.
+    NUM_EVENTS
+};
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#define EVENT_BIT(event) (1u << (event))
+
+
+//*****************************************************************************
+// Function declarations
+//*****************************************************************************
+void postEvent(uint8_t event);
+bool anyEventPending(void);
+uint32_t takeEvents(void);
+
+
+#endif /* EVENTS_H_ */
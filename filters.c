@@ -0,0 +1,268 @@
+// *******************************************************
+//
+// filters.c
+//
+// Filters for the altitude ADC samples, using integer
+// maths only. Samples are added from the ADC interrupt one
+// at a time, and the output is worked out once at the end
+// of each block, so a filter that is costly to evaluate is
+// only run at the block rate.
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include "filters.h"
+#include "driverlib/interrupt.h"
+#include "circBufT.h"
+
+
+//*****************************************************************************
+// Sample history for the boxcar, with a running sum, and for the FIR
+//*****************************************************************************
+CIRCBUF_SUM_DECLARE(BoxcarBuf, uint16_t, BOXCAR_SIZE)
+CIRCBUF_SUM_DEFINE(BoxcarBuf, uint16_t, BOXCAR_SIZE)
+CIRCBUF_DECLARE(FirBuf, uint16_t, FIR_TAPS)
+CIRCBUF_DEFINE(FirBuf, uint16_t, FIR_TAPS)
+CIRCBUF_DECLARE(MedianBuf, uint16_t, MEDIAN_SIZE)
+CIRCBUF_DEFINE(MedianBuf, uint16_t, MEDIAN_SIZE)
+
+
+//*****************************************************************************
+// Structure to represent a filter
+//*****************************************************************************
+typedef struct Filter {
+    void (*reset)(void);            // Clears the filter state.
+    void (*add)(uint16_t sample);   // Adds the next sample.
+    uint32_t (*output)(void);       // Works out the filtered value.
+} Filter;
+
+
+//*****************************************************************************
+// Globals to module
+//*****************************************************************************
+static BoxcarBuf_t g_boxcar;
+static FirBuf_t g_firHistory;
+static MedianBuf_t g_medianHistory;     // Median window in the order the samples came
+static uint16_t g_medianSorted[MEDIAN_SIZE];    // The same window kept in order of value
+static int32_t g_emaState = 0;          // EMA output with EMA_FRAC_BITS fraction bits
+static bool g_emaPrimed = false;        // Set once the EMA has been given a sample
+static const Filter* g_filter;          // The filter in use
+static volatile uint32_t g_output = 0;  // Output at the end of the last block
+
+// Binomial low-pass taps, oldest sample first. Delay (FIR_TAPS - 1) / 2.
+static const uint16_t g_firTaps[FIR_TAPS] = {1, 8, 28, 56, 70, 56, 28, 8, 1};
+
+
+//*****************************************************************************
+// Boxcar: rounded mean of the last BOXCAR_SIZE samples.
+//*****************************************************************************
+static void resetBoxcar(void)
+{
+    initBoxcarBuf(&g_boxcar);
+}
+
+static void addBoxcar(uint16_t sample)
+{
+    writeBoxcarBuf(&g_boxcar, sample);
+}
+
+static uint32_t outputBoxcar(void)
+{
+    return (2 * getBoxcarBufSum(&g_boxcar) + BOXCAR_SIZE) / 2 / BOXCAR_SIZE;
+}
+
+
+//*****************************************************************************
+// EMA: each sample moves the output 1 / 2^EMA_SHIFT of the way towards it.
+// Started from the first sample, so it does not ramp up from zero.
+//*****************************************************************************
+static void resetEma(void)
+{
+    g_emaState = 0;
+    g_emaPrimed = false;
+}
+
+static void addEma(uint16_t sample)
+{
+    int32_t target = ((int32_t) sample) << EMA_FRAC_BITS;
+    if (!g_emaPrimed) {
+        g_emaState = target;
+        g_emaPrimed = true;
+    }
+    g_emaState += (target - g_emaState) >> EMA_SHIFT;
+}
+
+static uint32_t outputEma(void)
+{
+    return (g_emaState + (1 << (EMA_FRAC_BITS - 1))) >> EMA_FRAC_BITS;
+}
+
+
+//*****************************************************************************
+// FIR: weighted sum of the last FIR_TAPS samples, worked out over the
+// history in place.
+//*****************************************************************************
+static void resetFir(void)
+{
+    initFirBuf(&g_firHistory);
+}
+
+static void addFir(uint16_t sample)
+{
+    writeFirBuf(&g_firHistory, sample);
+}
+
+static uint32_t outputFir(void)
+{
+    FirBufSpan_t span = snapshotFirBuf(&g_firHistory);
+    uint32_t sum = 0;
+    uint32_t i = 0;
+    for (i = 0; i < span.firstLen; i++) {
+        sum += (uint32_t) span.first[i] * g_firTaps[i];
+    }
+    for (i = 0; i < span.secondLen; i++) {
+        sum += (uint32_t) span.second[i] * g_firTaps[span.firstLen + i];
+    }
+    return (sum + (1 << (FIR_SHIFT - 1))) >> FIR_SHIFT;
+}
+
+
+//*****************************************************************************
+// Median: middle value of the last MEDIAN_SIZE samples. The window is kept
+// sorted as samples come in. The new sample takes the oldest one's place,
+// and is moved along until it is in order, so each sample costs at most
+// MEDIAN_SIZE steps and the window is never sorted from scratch.
+//*****************************************************************************
+static void resetMedian(void)
+{
+    uint32_t i = 0;
+    initMedianBuf(&g_medianHistory);
+    for (i = 0; i < MEDIAN_SIZE; i++) {
+        g_medianSorted[i] = 0;
+    }
+}
+
+static void addMedian(uint16_t sample)
+{
+    // Find where the oldest sample is in the sorted window
+    uint16_t oldest = readMedianBuf(&g_medianHistory);
+    writeMedianBuf(&g_medianHistory, sample);
+    uint32_t low = 0;
+    uint32_t high = MEDIAN_SIZE - 1;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (g_medianSorted[mid] < oldest) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    // Shuffle its neighbours down or up until the new sample fits
+    uint32_t pos = low;
+    if (sample > oldest) {
+        while (pos + 1 < MEDIAN_SIZE && g_medianSorted[pos + 1] < sample) {
+            g_medianSorted[pos] = g_medianSorted[pos + 1];
+            pos++;
+        }
+    } else {
+        while (pos > 0 && g_medianSorted[pos - 1] > sample) {
+            g_medianSorted[pos] = g_medianSorted[pos - 1];
+            pos--;
+        }
+    }
+    g_medianSorted[pos] = sample;
+}
+
+static uint32_t outputMedian(void)
+{
+    return g_medianSorted[MEDIAN_SIZE / 2];
+}
+
+
+//*****************************************************************************
+// Median then boxcar: spikes are taken out first, then the rest is smoothed.
+//*****************************************************************************
+static void resetMedianBoxcar(void)
+{
+    resetMedian();
+    resetBoxcar();
+}
+
+static void addMedianBoxcar(uint16_t sample)
+{
+    addMedian(sample);
+    addBoxcar(outputMedian());
+}
+
+
+//*****************************************************************************
+// Table of filters, in the order of filterTypes
+//*****************************************************************************
+static const Filter g_filters[NUM_FILTERS] = {
+    {resetBoxcar, addBoxcar, outputBoxcar},
+    {resetEma, addEma, outputEma},
+    {resetFir, addFir, outputFir},
+    {resetMedian, addMedian, outputMedian},
+    {resetMedianBoxcar, addMedianBoxcar, outputBoxcar},
+};
+
+
+//*****************************************************************************
+// Changes the filter the samples are passed through, starting it afresh.
+// The ADC interrupt uses the filter, so it is kept out while changing over.
+//*****************************************************************************
+void setFilter(uint8_t type)
+{
+    bool wasMasked = IntMasterDisable();
+    g_filter = &g_filters[type];
+    g_filter->reset();
+    if (!wasMasked) {
+        IntMasterEnable();
+    }
+}
+
+
+//*****************************************************************************
+// Passes the next sample through the filter. Called from the ADC interrupt.
+//*****************************************************************************
+void filterSample(uint16_t sample)
+{
+    g_filter->add(sample);
+}
+
+
+//*****************************************************************************
+// Works out the filter output from the samples so far. Called from the ADC
+// interrupt at the end of each block.
+//*****************************************************************************
+void updateFilterOutput(void)
+{
+    g_output = g_filter->output();
+}
+
+
+//*****************************************************************************
+// Returns the filter output at the end of the last block.
+//*****************************************************************************
+uint32_t getFilterOutput(void)
+{
+    return g_output;
+}
+
+
+//*****************************************************************************
+// Checks the boxcar running sum against its samples, correcting it if it has
+// drifted. Returns true if it matched. Must not be called while the ADC
+// interrupt can run.
+//*****************************************************************************
+bool checkFilter(void)
+{
+    return checkBoxcarBufSum(&g_boxcar);
+}
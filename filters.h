@@ -0,0 +1,53 @@
+#ifndef FILTERS_H_
+#define FILTERS_H_
+
+// *******************************************************
+//
+// filters.h
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#ifndef BOXCAR_SIZE
+#define BOXCAR_SIZE 20          // Samples averaged by the boxcar, delay (N - 1) / 2
+#endif
+#define EMA_SHIFT 3             // EMA weight of each new sample is 1 / 2^EMA_SHIFT
+#define EMA_FRAC_BITS 8         // Fraction bits kept in the EMA state
+#define FIR_TAPS 9              // Length of g_firTaps in filters.c
+#define FIR_SHIFT 8             // The taps add up to 2^FIR_SHIFT
+#ifndef MEDIAN_SIZE
+#define MEDIAN_SIZE 5           // Samples the median is taken over, must be odd
+#endif
+
+//*****************************************************************************
+// Enumeration of the filters the altitude can be passed through
+//*****************************************************************************
+enum filterTypes {
+    FILTER_BOXCAR = 0,  // Mean of the last BOXCAR_SIZE samples.
+    FILTER_EMA,         // Exponential moving average.
+    FILTER_FIR,         // Finite impulse response with the taps in filters.c.
+    FILTER_MEDIAN,      // Median of the last MEDIAN_SIZE samples, rejects spikes.
+    FILTER_MEDIAN_BOXCAR,   // Median, then the boxcar of the medians.
+    NUM_FILTERS
+};
+
+
+//*****************************************************************************
+// Function declarations
+//*****************************************************************************
+void setFilter(uint8_t type);
+void filterSample(uint16_t sample);
+void updateFilterOutput(void);
+uint32_t getFilterOutput(void);
+bool checkFilter(void);
+
+
+#endif /* FILTERS_H_ */
@@ -15,48 +15,669 @@
 //*****************************************************************************
 #include "kernel.h"
 #include "timings.h"
+#include "trace.h"
+
+
+//*****************************************************************************
+// Globals to module
+//*****************************************************************************
+static Process* g_processes;        // The list of processes being run
+static int g_numProcesses = 0;      // Number of processes in the list
+static Process* g_foreground;       // The process run from the foreground timer
+static SchedulerStats g_schedulerStats;
+static Process* g_current;          // The process currently being run
+static uint8_t g_idleContext = 0;   // What the system is doing, e.g. the flight state
+static uint32_t g_contextStart;     // Tick the current idle context was entered
+static uint64_t g_contextTicks[KERNEL_IDLE_CONTEXTS];   // Time spent in each context
+static uint64_t g_sleepTicks[KERNEL_IDLE_CONTEXTS];     // Time asleep in each context
+static uint64_t g_loadWindowStart;          // Time the current utilisation window began
+static uint32_t g_backgroundCycles = 0;     // Cycles run by background processes this window
+static volatile uint32_t g_foregroundCycles = 0;    // Cycles run by the foreground, never reset
+static uint32_t g_windowForegroundStart = 0;        // Foreground cycles when the window began
+static uint32_t g_utilisation = 0;          // Utilisation over the last window, in permille
+static bool g_shedding = false;             // Set while low priority work is slowed down
 
 
 //*****************************************************************************
 // Checks the process needs to be run.
 //*****************************************************************************
-bool shouldRunProcess(Process process)
+bool shouldRunProcess(const Process* process, uint32_t events)
 {
-    return (process.lastRunRef == 0 || process.rate == KERNEL_MAX_RATE || shouldBeRun(process.lastRunRef, process.rate));
+    if (process->suspended) {
+        return false;
+    }
+    if (process->type == KERNEL_EVENT && !process->resume) {
+        return (process->events & events) != 0;
+    }
+    return (getProcessDelay(process, getCurTicks()) == 0);
 }
 
 
 //*****************************************************************************
-// Runs the main round robin loop.
-// Takes the following parameters...
+// Clears the timing statistics of a single process.
+//*****************************************************************************
+static void clearStats(ProcessStats* stats)
+{
+    stats->runCount = 0;
+    stats->minExecTime = UINT32_MAX;
+    stats->maxExecTime = 0;
+    stats->totalExecTime = 0;
+    stats->minStartLatency = UINT32_MAX;
+    stats->maxStartLatency = 0;
+    stats->missedPeriods = 0;
+    stats->minInterval = UINT32_MAX;
+    stats->maxInterval = 0;
+    stats->skippedReleases = 0;
+    stats->catchUpRuns = 0;
+    stats->reanchors = 0;
+    stats->maxResponseTime = 0;
+}
+
+
+//*****************************************************************************
+// Records how late a process started after it was due.
+//*****************************************************************************
+static void recordStartLatency(ProcessStats* stats, uint32_t latency)
+{
+    if (latency < stats->minStartLatency) {
+        stats->minStartLatency = latency;
+    }
+    if (latency > stats->maxStartLatency) {
+        stats->maxStartLatency = latency;
+    }
+}
+
+
+//*****************************************************************************
+// Moves the release time of a process on to its next period, and applies its
+// overrun policy if whole periods were missed. Releases stay anchored to the
+// original start, so late starts do not push later releases back. Missed
+// periods are counted once, when they are first seen, and not again on each
+// run that catches them up.
+//*****************************************************************************
+static void releaseProcess(Process* process, uint32_t start)
+{
+    ProcessStats* stats = &process->stats;
+    uint32_t period = process->period;
+    uint32_t late = start - process->nextRelease;
+    uint32_t missed = 0;
+
+    // Space low priority releases further apart while overloaded
+    if (g_shedding && process->priority == KERNEL_PRIORITY_LOW) {
+        period *= KERNEL_SHED_FACTOR;
+    }
+
+    if (late >= period) {
+        missed = late / period;
+    }
+
+    // This run is for one of the owed releases, the rest were counted already
+    uint32_t counted = (process->owedRuns > 0) ? (process->owedRuns - 1) : 0;
+    recordStartLatency(stats, late);
+    if (missed > counted) {
+        stats->missedPeriods += missed - counted;
+    }
+    process->owedRuns = 0;
+
+    if (missed == 0) {
+        process->nextRelease += period;
+        return;
+    }
+
+    switch (process->policy)
+    {
+        case KERNEL_SKIP_MISSED:
+            // Drop the missed releases and keep to the original grid
+            process->nextRelease += period * (missed + 1);
+            stats->skippedReleases += missed;
+            break;
+
+        case KERNEL_CATCH_UP:
+            // Still due afterwards, so it runs again on the next pass. Each
+            // extra run owed is counted once, like the missed periods
+            process->nextRelease += period;
+            process->owedRuns = missed;
+            if (missed > counted) {
+                stats->catchUpRuns += missed - counted;
+            }
+            break;
+
+        case KERNEL_REANCHOR:
+            // Start a new grid from this run
+            process->nextRelease = start + period;
+            stats->reanchors++;
+            break;
+    }
+}
+
+
+//*****************************************************************************
+// Runs a process, recording how late it started and how long it took.
+// Returns the number of cycles the process ran for. For a process that
+// yields, each slice is counted as a run, so the execution time stats show
+// the longest the process held the CPU in one go.
+//*****************************************************************************
+static uint32_t runProcess(Process* process)
+{
+    ProcessStats* stats = &process->stats;
+    uint32_t start = getCurTicks();
+    bool resumed = process->resume;
+
+    // Record how far past its due time the process started. A foreground
+    // process is due when its timer expires. Resuming a process that yielded
+    // is not a new release.
+    if (resumed) {
+        process->resume = false;
+    } else if (process->type == KERNEL_FOREGROUND) {
+        uint32_t lateness = getForegroundTimerLateness();
+        recordStartLatency(stats, lateness);
+        process->lastRelease = start - lateness;
+    } else if (process->type == KERNEL_BACKGROUND && process->rate != KERNEL_MAX_RATE) {
+        process->lastRelease = process->nextRelease;
+        releaseProcess(process, start);
+    } else {
+        process->lastRelease = start;
+    }
+
+    // Record the time between starts, to show the period jitter
+    uint32_t startCycles = getCycleCount();
+    if (!resumed) {
+        if (stats->runCount > 0) {
+            uint32_t interval = startCycles - process->lastStartCycles;
+            if (interval < stats->minInterval) {
+                stats->minInterval = interval;
+            }
+            if (interval > stats->maxInterval) {
+                stats->maxInterval = interval;
+            }
+        }
+        process->lastStartCycles = startCycles;
+    }
+
+    // Run the actual function, timing it with the cycle counter. The current
+    // process is restored afterwards in case this preempted another one.
+    Process* preempted = g_current;
+    g_current = process;
+    TRACE_BEGIN(TRACE_ID_TASK + (process - g_processes));
+    process->handler();
+    TRACE_END(TRACE_ID_TASK + (process - g_processes));
+    g_current = preempted;
+    uint32_t execTime = getCycleCount() - startCycles;
+
+    stats->runCount++;
+    stats->totalExecTime += execTime;
+    if (execTime < stats->minExecTime) {
+        stats->minExecTime = execTime;
+    }
+    if (execTime > stats->maxExecTime) {
+        stats->maxExecTime = execTime;
+    }
+
+    // A process that yielded has not finished, so has no response time yet
+    if (!process->resume) {
+        uint32_t response = getCurTicks() - process->lastRelease;
+        if (response > stats->maxResponseTime) {
+            stats->maxResponseTime = response;
+        }
+    }
+
+    // Count towards the utilisation. Each side has its own total as the
+    // foreground can interrupt the background part way through adding.
+    if (process->type == KERNEL_FOREGROUND) {
+        g_foregroundCycles += execTime;
+    } else {
+        g_backgroundCycles += execTime;
+    }
+    return execTime;
+}
+
+
+//*****************************************************************************
+// Returns the number of ticks until the process is next due, or 0 if it is
+// due now. Processes that are not run on time are never due.
+//*****************************************************************************
+uint32_t getProcessDelay(const Process* process, uint32_t now)
+{
+    if (process->suspended) {
+        return TIMING_MAX_SLEEP_TICKS;
+    }
+    if (process->resume) {
+        int32_t waiting = process->resumeAt - now;
+        return (waiting > 0) ? waiting : 0;
+    }
+    if (process->type != KERNEL_BACKGROUND) {
+        return TIMING_MAX_SLEEP_TICKS;
+    }
+
+    // Wrap-safe as long as releases are less than 2^31 ticks apart.
+    int32_t late = now - process->nextRelease;
+    if (late >= 0 || process->period == 0) {
+        return 0;
+    }
+    return -late;
+}
+
+
+//*****************************************************************************
+// Returns the number of ticks until the earliest process in the list is due.
+//*****************************************************************************
+uint32_t getNextDelay(const Process processes[], int n)
+{
+    uint32_t now = getCurTicks();
+    uint32_t nextDelay = TIMING_MAX_SLEEP_TICKS;
+    int i = 0;
+    for (i = 0; i < n; i++) {
+        uint32_t delay = getProcessDelay(&processes[i], now);
+        if (delay < nextDelay) {
+            nextDelay = delay;
+        }
+    }
+    return nextDelay;
+}
+
+
+//*****************************************************************************
+// Records the cycles a scheduler pass spent outside of the processes.
+//*****************************************************************************
+static void recordSchedulerOverhead(uint32_t overhead)
+{
+    g_schedulerStats.passCount++;
+    g_schedulerStats.totalOverhead += overhead;
+    if (overhead > g_schedulerStats.maxOverhead) {
+        g_schedulerStats.maxOverhead = overhead;
+    }
+}
+
+
+//*****************************************************************************
+// Works out the utilisation at the end of each window, and starts or stops
+// slowing down low priority processes. The gap between the two thresholds
+// stops it switching back and forth. A foreground run that interrupts a
+// background one is counted in both, so the figure errs on the high side.
+// Reading the 64-bit time here on every pass also keeps it extended.
+//*****************************************************************************
+static void updateLoadShedding(void)
+{
+    uint64_t now = getCurTime();
+    uint64_t elapsed = now - g_loadWindowStart;
+    if (elapsed < KERNEL_LOAD_WINDOW_TICKS) {
+        return;
+    }
+
+    uint32_t foregroundCycles = g_foregroundCycles;
+    uint64_t busy = g_backgroundCycles + (foregroundCycles - g_windowForegroundStart);
+    g_utilisation = (busy * 1000) / elapsed;
+
+    if (g_utilisation > KERNEL_SHED_PERMILLE) {
+        g_shedding = true;
+    } else if (g_utilisation < KERNEL_RESTORE_PERMILLE) {
+        g_shedding = false;
+    }
+
+    g_loadWindowStart = now;
+    g_backgroundCycles = 0;
+    g_windowForegroundStart = foregroundCycles;
+}
+
+
+//*****************************************************************************
+// Interrupt handler for the foreground timer. Runs the foreground process.
+//*****************************************************************************
+static void foregroundIntHandler(void)
+{
+    clearForegroundTimer();
+    runProcess(g_foreground);
+}
+
+
+//*****************************************************************************
+// Adds the time since it was last done to the current idle context. Done
+// every time the kernel sleeps, so the 32-bit tick difference cannot wrap.
+//*****************************************************************************
+static void accountIdleContext(void)
+{
+    uint32_t now = getCurTicks();
+    g_contextTicks[g_idleContext] += now - g_contextStart;
+    g_contextStart = now;
+}
+
+
+#if KERNEL_IDLE_SLEEP
+//*****************************************************************************
+// Runs every process that is due or has an event waiting, then sleeps until
+// the next one is due or an event is posted.
+//*****************************************************************************
+static void runDeadlinePass(Process processes[], int n)
+{
+    uint32_t passStart = getCycleCount();
+    uint32_t taskCycles = 0;
+    uint32_t events = takeEvents();
+    uint32_t now = getCurTicks();
+    int i = 0;
+    for (i = 0; i < n; i++) {
+        bool due = (processes[i].type == KERNEL_EVENT && !processes[i].resume && !processes[i].suspended)
+                ? ((processes[i].events & events) != 0)
+                : (getProcessDelay(&processes[i], now) == 0);
+        if (due) {
+            taskCycles += runProcess(&processes[i]);
+            now = getCurTicks();
+        }
+    }
+
+    updateLoadShedding();
+
+    // Sleep until the earliest deadline, unless it is too close to bother.
+    // The sleep is skipped if an event was posted since the events were taken.
+    uint32_t nextDelay = getNextDelay(processes, n);
+    recordSchedulerOverhead(getCycleCount() - passStart - taskCycles);
+    if (nextDelay >= KERNEL_MIN_SLEEP_TICKS) {
+        TRACE_BEGIN(TRACE_ID_SLEEP);
+        uint32_t slept = sleepFor(nextDelay);
+        TRACE_END(TRACE_ID_SLEEP);
+        if (slept > 0) {
+            g_sleepTicks[g_idleContext] += slept;
+            accountIdleContext();
+        }
+    }
+}
+
+
+#else
+//*****************************************************************************
+// Checks every process in turn and runs the ones that are due.
+//*****************************************************************************
+static void runPollingPass(Process processes[], int n)
+{
+    uint32_t passStart = getCycleCount();
+    uint32_t taskCycles = 0;
+    uint32_t events = takeEvents();
+    int i = 0;
+    for (i = 0; i < n; i++) {
+
+        // Check if this process should be run
+        if (shouldRunProcess(&processes[i], events)) {
+            taskCycles += runProcess(&processes[i]);
+        }
+    }
+    updateLoadShedding();
+    recordSchedulerOverhead(getCycleCount() - passStart - taskCycles);
+}
+#endif
+
+
+//*****************************************************************************
+// Sets up the kernel to run the given processes, releasing all of them now
+// and starting the foreground timer. Takes the following parameters...
 //
 // processes: List of processes to run.
 // n: Number of processes in the list of
 //*****************************************************************************
-void runKernel(Process processes[], int n)
+void initKernel(Process processes[], int n)
 {
-    // Set the initial last run reference
+    g_processes = processes;
+    g_numProcesses = n;
+    g_foreground = 0;
+    resetSchedulerStats();
+    g_contextStart = getCurTicks();
+    g_loadWindowStart = getCurTime();
+
+    // Release every process now
+    uint32_t now = getCurTicks();
     int i = 0;
     for (i = 0; i < n; i++) {
-        processes[i].lastRunRef = 0;
+        processes[i].nextRelease = now;
+        processes[i].owedRuns = 0;
+        clearStats(&processes[i].stats);
+        if (processes[i].type == KERNEL_FOREGROUND) {
+            g_foreground = &processes[i];
+        }
+    }
+
+    // Start the foreground process at its fixed rate
+    if (g_foreground != 0) {
+        initForegroundTimer(g_foreground->rate, KERNEL_FOREGROUND_PRIORITY, foregroundIntHandler);
     }
 
+#if KERNEL_IDLE_SLEEP
+    initWakeTimer();
+#endif
+}
+
+
+//*****************************************************************************
+// Makes one pass over the processes set up by initKernel. Lets the schedule
+// be stepped from outside, such as against the virtual timings on a host.
+//*****************************************************************************
+void runKernelPass(void)
+{
+#if KERNEL_IDLE_SLEEP
+    runDeadlinePass(g_processes, g_numProcesses);
+#else
+    runPollingPass(g_processes, g_numProcesses);
+#endif
+}
+
+
+//*****************************************************************************
+// Runs the main round robin loop.
+// Takes the following parameters...
+//
+// processes: List of processes to run.
+// n: Number of processes in the list of
+//*****************************************************************************
+void runKernel(Process processes[], int n)
+{
+    initKernel(processes, n);
+
     // Run the main schedule
     while (1) {
-        for (i = 0; i < n; i++) {
+        runKernelPass();
+    }
+}
 
-            // Check if this process should be run
-            if (shouldRunProcess(processes[i])) {
 
-                // Reset the reference time
-                processes[i].lastRunRef = getCurTime();
+//*****************************************************************************
+// Marks the running process to be run again on the next pass, whether or not
+// it is due. Used by TASK_YIELD, and has no effect on a foreground process.
+//*****************************************************************************
+void resumeNextPass(void)
+{
+    resumeAfter(0);
+}
 
-                // Run the actual function
-                processes[i].handler();
-            }
+
+//*****************************************************************************
+// Marks the running process to be run again once the given number of ticks
+// has passed, whether or not it is due. The kernel can sleep until then.
+// Used by TASK_YIELD_FOR, and has no effect on a foreground process.
+//*****************************************************************************
+void resumeAfter(uint32_t ticks)
+{
+    if (g_current != 0 && g_current->type != KERNEL_FOREGROUND) {
+        g_current->resume = true;
+        g_current->resumeAt = getCurTicks() + ticks;
+    }
+}
+
+
+//*****************************************************************************
+// Returns the number of processes being run by the kernel.
+//*****************************************************************************
+int getNumProcesses(void)
+{
+    return g_numProcesses;
+}
+
+
+//*****************************************************************************
+// Returns the name of the process at the given index.
+//*****************************************************************************
+const char* getProcessName(int index)
+{
+    return g_processes[index].name;
+}
+
+
+//*****************************************************************************
+// Returns a copy of the timing statistics of the process at the given index.
+//*****************************************************************************
+ProcessStats getProcessStats(int index)
+{
+    return g_processes[index].stats;
+}
+
+
+//*****************************************************************************
+// Returns the mean run time in cycles of the process at the given index.
+//*****************************************************************************
+uint32_t getProcessMeanExecTime(int index)
+{
+    ProcessStats stats = g_processes[index].stats;
+    if (stats.runCount == 0) {
+        return 0;
+    }
+    return stats.totalExecTime / stats.runCount;
+}
+
+
+//*****************************************************************************
+// Clears the timing statistics of every process.
+//*****************************************************************************
+void resetProcessStats(void)
+{
+    int i = 0;
+    for (i = 0; i < g_numProcesses; i++) {
+        clearStats(&g_processes[i].stats);
+    }
+}
+
+
+//*****************************************************************************
+// Returns a copy of the scheduler overhead statistics.
+//*****************************************************************************
+SchedulerStats getSchedulerStats(void)
+{
+    return g_schedulerStats;
+}
+
+
+//*****************************************************************************
+// Clears the scheduler overhead statistics.
+//*****************************************************************************
+void resetSchedulerStats(void)
+{
+    g_schedulerStats.passCount = 0;
+    g_schedulerStats.totalOverhead = 0;
+    g_schedulerStats.maxOverhead = 0;
+}
+
+
+//*****************************************************************************
+// Changes the rate in HZ of the foreground process, e.g. to slow the
+// controller down while it has nothing to control.
+//*****************************************************************************
+void setForegroundRate(uint32_t rate)
+{
+    if (g_foreground != 0) {
+        g_foreground->rate = rate;
+        g_foreground->period = getTicksPerPeriod(rate);
+        setForegroundTimerRate(rate);
+    }
+}
+
+
+//*****************************************************************************
+// Sets what the system is currently doing, so the time spent asleep can be
+// measured separately for each context. Cheap to call when nothing changes.
+//*****************************************************************************
+void setIdleContext(uint8_t context)
+{
+    if (context == g_idleContext || context >= KERNEL_IDLE_CONTEXTS) {
+        return;
+    }
+
+    accountIdleContext();
+    g_idleContext = context;
+}
+
+
+//*****************************************************************************
+// Returns the fraction of time spent asleep in a context, in tenths of a
+// percent.
+//*****************************************************************************
+uint32_t getIdlePermille(uint8_t context)
+{
+    uint64_t total = g_contextTicks[context];
+    if (total == 0) {
+        return 0;
+    }
+    return (g_sleepTicks[context] * 1000) / total;
+}
+
+
+//*****************************************************************************
+// Returns the first process run by the given handler, or 0 if there is none.
+//*****************************************************************************
+Process* findProcess(void (*handler)(void))
+{
+    int i = 0;
+    for (i = 0; i < g_numProcesses; i++) {
+        if (g_processes[i].handler == handler) {
+            return &g_processes[i];
         }
     }
+    return 0;
+}
+
+
+//*****************************************************************************
+// Stops a background or event process from being run until it is resumed.
+//*****************************************************************************
+void suspendProcess(Process* process)
+{
+    process->suspended = true;
+}
+
+
+//*****************************************************************************
+// Lets a suspended process run again. A periodic process is released at
+// once rather than catching up on the time it was suspended for.
+//*****************************************************************************
+void resumeProcess(Process* process)
+{
+    if (process->suspended) {
+        process->nextRelease = getCurTicks();
+        process->owedRuns = 0;
+        process->suspended = false;
+    }
+}
 
+
+//*****************************************************************************
+// Changes the rate in HZ of a background process. The new period starts
+// from its next release.
+//*****************************************************************************
+void setProcessRate(Process* process, uint32_t rate)
+{
+    process->rate = rate;
+    process->period = (rate == KERNEL_MAX_RATE) ? 0 : getTicksPerPeriod(rate);
 }
 
 
+//*****************************************************************************
+// Returns the share of the CPU used by processes over the last measurement
+// window, in tenths of a percent.
+//*****************************************************************************
+uint32_t getUtilisation(void)
+{
+    return g_utilisation;
+}
+
+
+//*****************************************************************************
+// Returns true while low priority processes are being slowed down.
+//*****************************************************************************
+bool isShedding(void)
+{
+    return g_shedding;
+}
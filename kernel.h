@@ -9,8 +9,10 @@
 //
 // int main(void)
 // {
-//      Process processes[1] = {*testFunc, 1};
-//      runKernel(processes, 1);
+//      static Process processes[] = {
+//          KERNEL_TASK(testFunc, 1, "test", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_LOW)
+//      };
+//      runKernel(processes, KERNEL_TABLE_SIZE(processes));
 // }
 //
 //*****************************************************************************
@@ -20,11 +22,125 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "timings.h"
+#include "events.h"
 
 //*****************************************************************************
 // Constants
 //*****************************************************************************
 #define KERNEL_MAX_RATE 0
+#ifndef KERNEL_IDLE_SLEEP
+#define KERNEL_IDLE_SLEEP 1             // 1 to sleep until the next deadline, 0 to busy-poll
+#endif
+#define KERNEL_MIN_SLEEP_TICKS US_TO_TICKS(10)  // Delays shorter than this are spun instead of slept
+#define KERNEL_FOREGROUND_PRIORITY 0x20 // Below the sensor interrupts, which stay at 0
+#define KERNEL_IDLE_CONTEXTS 8          // Number of contexts idle time is measured for
+#define KERNEL_LOAD_WINDOW_TICKS (SYSTEM_CLOCK_HZ / 10)   // Utilisation is measured every 100 ms
+#define KERNEL_SHED_PERMILLE 800        // Low priority work is slowed above this utilisation
+#define KERNEL_RESTORE_PERMILLE 600     // and brought back to full rate below this one
+#define KERNEL_SHED_FACTOR 4            // Low priority periods are multiplied by this when shed
+
+//*****************************************************************************
+// Macros for building a process table at compile time. Periods are worked
+// out in timer ticks from the system clock, so nothing is divided at run time.
+//*****************************************************************************
+#define KERNEL_RATE_TO_TICKS(rate) ((rate) == KERNEL_MAX_RATE ? 0 : (SYSTEM_CLOCK_HZ / (rate)))
+#define KERNEL_TASK(handler, rate, name, policy, priority) \
+    {handler, rate, name, KERNEL_BACKGROUND, policy, KERNEL_RATE_TO_TICKS(rate), 0, priority}
+#define KERNEL_FOREGROUND_TASK(handler, rate, name) \
+    {handler, rate, name, KERNEL_FOREGROUND, KERNEL_SKIP_MISSED, KERNEL_RATE_TO_TICKS(rate), 0, KERNEL_PRIORITY_HIGH}
+#define KERNEL_EVENT_TASK(handler, events, name, priority) \
+    {handler, 0, name, KERNEL_EVENT, KERNEL_SKIP_MISSED, 0, events, priority}
+#define KERNEL_TABLE_SIZE(table) ((int) (sizeof(table) / sizeof((table)[0])))
+
+//*****************************************************************************
+// Macros for stackless coroutines, so a long background process can give the
+// CPU back part way through and carry on from the same point next pass.
+// TASK_YIELD_FOR carries on once the given number of ticks has passed
+// instead, so a process waiting on hardware lets the kernel sleep.
+// Local variables are not kept across a yield, so use statics. Only one
+// TASK_YIELD or TASK_YIELD_FOR may be used per source line. TASK_EXIT
+// finishes early, so the next run starts again from the top.
+//
+// void longTask(void)
+// {
+//     static TaskState state;
+//     TASK_BEGIN(&state);
+//     doFirstHalf();
+//     TASK_YIELD(&state);
+//     doSecondHalf();
+//     TASK_END(&state);
+// }
+//*****************************************************************************
+typedef uint16_t TaskState;
+
+#define TASK_BEGIN(state) switch (*(state)) { case 0:
+#define TASK_YIELD(state) \
+    do { *(state) = __LINE__; resumeNextPass(); return; case __LINE__:; } while (0)
+#define TASK_YIELD_FOR(state, ticks) \
+    do { *(state) = __LINE__; resumeAfter(ticks); return; case __LINE__:; } while (0)
+#define TASK_EXIT(state) do { *(state) = 0; return; } while (0)
+#define TASK_END(state) } *(state) = 0
+
+//*****************************************************************************
+// Enumeration of the ways a process can be run
+//*****************************************************************************
+enum processTypes {
+    KERNEL_BACKGROUND = 0,  // Run round robin from the main loop.
+    KERNEL_FOREGROUND = 1,  // Run from a periodic timer interrupt. Only one is supported.
+    KERNEL_EVENT = 2        // Run from the main loop when one of its events is posted.
+};
+
+//*****************************************************************************
+// Enumeration of process priorities. Only KERNEL_PRIORITY_LOW processes are
+// slowed down when the kernel is overloaded.
+//*****************************************************************************
+enum processPriorities {
+    KERNEL_PRIORITY_LOW = 0,
+    KERNEL_PRIORITY_NORMAL = 1,
+    KERNEL_PRIORITY_HIGH = 2
+};
+
+
+//*****************************************************************************
+// Enumeration of what to do when a process misses whole periods
+//*****************************************************************************
+enum overrunPolicies {
+    KERNEL_SKIP_MISSED = 0, // Drop the missed releases and wait for the next one.
+    KERNEL_CATCH_UP = 1,    // Run once for every missed release, back to back.
+    KERNEL_REANCHOR = 2     // Run once and schedule the next release from now.
+};
+
+
+//*****************************************************************************
+// Structure to hold the timing statistics of a process
+//*****************************************************************************
+typedef struct ProcessStats {
+    uint32_t runCount;          // Number of times the process has been run.
+    uint32_t minExecTime;       // Shortest run time in cycles.
+    uint32_t maxExecTime;       // Longest run time in cycles.
+    uint64_t totalExecTime;     // Sum of all run times in cycles, for the mean.
+    uint32_t minStartLatency;   // Earliest start in ticks after it was due.
+    uint32_t maxStartLatency;   // Latest start in ticks after it was due.
+    uint32_t missedPeriods;     // Whole periods that passed without a run.
+    uint32_t minInterval;       // Shortest time in cycles between two starts.
+    uint32_t maxInterval;       // Longest time in cycles between two starts.
+    uint32_t skippedReleases;   // Releases dropped by KERNEL_SKIP_MISSED.
+    uint32_t catchUpRuns;       // Extra runs KERNEL_CATCH_UP owed for missed releases.
+    uint32_t reanchors;         // Times KERNEL_REANCHOR restarted the schedule.
+    uint32_t maxResponseTime;   // Longest time in ticks from release to finishing.
+} ProcessStats;
+
+
+//*****************************************************************************
+// Structure to hold the cost of the scheduler itself
+//*****************************************************************************
+typedef struct SchedulerStats {
+    uint32_t passCount;         // Number of scheduler passes made.
+    uint32_t maxOverhead;       // Most cycles a pass spent outside the processes.
+    uint64_t totalOverhead;     // Sum of those cycles, for the mean.
+} SchedulerStats;
+
 
 //*****************************************************************************
 // Structure to represent a process
@@ -32,15 +148,50 @@
 typedef struct Process {
     void (*handler)(void);  // The function handler for the process.
     uint32_t rate;          // The rate in HZ to try and schedule the task at.
-    uint64_t lastRunRef;    // Set automatically when the function is run.
+    const char* name;       // Short name used when reporting statistics.
+    uint8_t type;           // KERNEL_BACKGROUND (default) or KERNEL_FOREGROUND.
+    uint8_t policy;         // Overrun policy, KERNEL_SKIP_MISSED by default.
+    uint32_t period;        // Ticks between runs, 0 for KERNEL_MAX_RATE.
+    uint32_t events;        // EVENT_BIT mask that runs a KERNEL_EVENT process.
+    uint8_t priority;       // KERNEL_PRIORITY_LOW, _NORMAL or _HIGH.
+    bool suspended;         // Set while the process is suspended and never run.
+    uint32_t nextRelease;   // Tick the process is next due, set automatically.
+    uint32_t owedRuns;      // Releases already missed that KERNEL_CATCH_UP still has to run.
+    ProcessStats stats;     // Timing statistics, gathered automatically.
+    uint32_t lastStartCycles;   // Cycle count at the last start, for the interval.
+    uint32_t lastRelease;   // Tick the current run was due, for the response time.
+    bool resume;            // Set when the process yielded and must be run again.
+    uint32_t resumeAt;      // Tick a process that yielded is run again from.
 } Process;
 
 
 //*****************************************************************************
 // Function declarations
 //*****************************************************************************
-bool shouldRunProcess(Process process);
+bool shouldRunProcess(const Process* process, uint32_t events);
+uint32_t getProcessDelay(const Process* process, uint32_t now);
+uint32_t getNextDelay(const Process processes[], int n);
+void initKernel(Process processes[], int n);
+void runKernelPass(void);
 void runKernel(Process processes[], int n);
+void resumeNextPass(void);
+void resumeAfter(uint32_t ticks);
+int getNumProcesses(void);
+const char* getProcessName(int index);
+ProcessStats getProcessStats(int index);
+uint32_t getProcessMeanExecTime(int index);
+void resetProcessStats(void);
+SchedulerStats getSchedulerStats(void);
+void resetSchedulerStats(void);
+void setForegroundRate(uint32_t rate);
+Process* findProcess(void (*handler)(void));
+void suspendProcess(Process* process);
+void resumeProcess(Process* process);
+void setProcessRate(Process* process, uint32_t rate);
+uint32_t getUtilisation(void);
+bool isShedding(void);
+void setIdleContext(uint8_t context);
+uint32_t getIdlePermille(uint8_t context);
 
 
 #endif /* KERNEL_H_ */
@@ -26,14 +26,26 @@
 //*****************************************************************************
 // Constants
 //*****************************************************************************
-#define NUM_TASKS 4
+#define CONTROL_FOREGROUND 1     // 1 to run the controller from a timer interrupt
+#define CONTROL_RATE_HZ 1000     // Controller rate when run in the foreground
+#define CONTROL_LANDED_RATE_HZ 10   // Controller rate while landed, to let the CPU sleep
+#define CONTROLS_RATE_HZ 50      // Flight state polling rate, buttons also run it on an edge
+#define DISPLAY_RATE_HZ 4
+#define DISPLAY_BUSY_RATE_HZ 1   // Display rate while seeking and landing, to keep control tight
+#define SEND_KERNEL_STATS 0      // 1 to periodically dump task timing over serial
+#define KERNEL_STATS_RATE 1
 
 
 //*****************************************************************************
 // Globals
 //*****************************************************************************
 uint64_t prevControlTime = 0;
+uint32_t controlPeriod;
+bool lowPower = false;
+uint8_t ratesState = LANDED_LOCK;    // Flight state the task rates were last set for
 int32_t altitude;
+int32_t altitudeFixed;               // Altitude in 1/ALTITUDE_FRAC_SCALE of a percent
+int32_t altitudeRate;                // Climb rate in 1/ALTITUDE_FRAC_SCALE of a percent per second
 uint32_t yaw;
 uint32_t mainDuty;
 uint32_t tailDuty;
@@ -52,6 +64,29 @@ void runController();
 void refreshDisplay();
 void checkControls();
 void sendSerialData();
+void updatePowerMode(void);
+void updateTaskRates(void);
+
+
+//*****************************************************************************
+// Task table, with periods worked out at compile time
+//*****************************************************************************
+static Process tasks[] = {
+    KERNEL_EVENT_TASK(processAltitudeBlocks, EVENT_BIT(EVENT_ADC_BLOCK), "altitude", KERNEL_PRIORITY_HIGH),
+#if CONTROL_FOREGROUND
+    KERNEL_FOREGROUND_TASK(runController, CONTROL_RATE_HZ, "control"),
+#else
+    KERNEL_EVENT_TASK(runController, EVENT_BIT(EVENT_ADC_BLOCK), "control", KERNEL_PRIORITY_HIGH),
+#endif
+    KERNEL_TASK(refreshDisplay, DISPLAY_RATE_HZ, "display", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_LOW),
+    KERNEL_TASK(checkControls, CONTROLS_RATE_HZ, "controls", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_HIGH),
+    KERNEL_EVENT_TASK(checkControls, EVENT_BIT(EVENT_BUTTON_EDGE) | EVENT_BIT(EVENT_YAW_REF_FOUND)
+                      | EVENT_BIT(EVENT_SLIDER_EDGE), "inputs", KERNEL_PRIORITY_HIGH),
+    KERNEL_TASK(sendSerialData, 5, "serial", KERNEL_CATCH_UP, KERNEL_PRIORITY_NORMAL),
+#if SEND_KERNEL_STATS
+    KERNEL_TASK(sendKernelStats, KERNEL_STATS_RATE, "stats", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_LOW),
+#endif
+};
 
 
 //*****************************************************************************
@@ -59,8 +94,8 @@ void sendSerialData();
 //*****************************************************************************
 void initClock (void)
 {
-    // Set the clock rate to 20 MHz
-    SysCtlClockSet (SYSCTL_SYSDIV_10 | SYSCTL_USE_PLL | SYSCTL_OSC_MAIN |
+    // Set the clock rate to SYSTEM_CLOCK_HZ
+    SysCtlClockSet (SYSTEM_CLOCK_DIV | SYSCTL_USE_PLL | SYSCTL_OSC_MAIN |
                    SYSCTL_XTAL_16MHZ);
     // Set PWM clock
     SysCtlPWMClockSet(PWM_DIVIDER_CODE);
@@ -72,6 +107,10 @@ void initClock (void)
 //*****************************************************************************
 void init(void) {
    initClock();
+
+   // The time base has to run before any interrupt that reads it is enabled,
+   // such as the button edges from initControls
+   initTimer();
    initAltitude();
    initDisplay();
    initControls();
@@ -79,15 +118,15 @@ void init(void) {
    initMainPWM();
    initTailPWM();
    initSerial();
-   initTimer();
    initReset();
+   controlPeriod = getTicksPerPeriod(CONTROL_RATE_HZ);
 
    // Enable interrupts to the processor.
    IntMasterEnable();
 
-   // Take landed sample
-   SysCtlDelay (SysCtlClockGet() / 6);
-   takeLandedSample();
+   // Find the landed altitude, as soon as the samples are in
+   calibrateLanded();
+   sendCalibration();
 }
 
 
@@ -96,15 +135,21 @@ void init(void) {
 //*****************************************************************************
 void runController() {
     // Get the altitude and yaw
-    altitude = getAltitudePercent();
+    altitudeFixed = getAltitudeCentiPercent();
+    altitude = altitudeFixed / ALTITUDE_FRAC_SCALE;
+    altitudeRate = getAltitudeRate();
     yaw = getYaw();
 
     // Calculate time
     uint64_t currentTime = getCurTime();
+#if CONTROL_FOREGROUND
+    uint64_t deltaTime = controlPeriod;
+#else
     uint64_t deltaTime = getTimeDiff(prevControlTime, currentTime);
+#endif
 
     // Run PI controll
-    mainDuty = runAltitudeControl(altitude, desiredAltitude, deltaTime);
+    mainDuty = runAltitudeControl(altitudeFixed, desiredAltitude * ALTITUDE_FRAC_SCALE, altitudeRate, deltaTime);
     tailDuty = runYawControl(yaw, desiredYaw, deltaTime);
     setMainPWM(mainDuty);
     setTailPWM(tailDuty);
@@ -224,6 +269,55 @@ void checkControls()
             }
             break;
     }
+
+    updatePowerMode();
+    updateTaskRates();
+    setIdleContext(flightState);
+}
+
+
+//*****************************************************************************
+// Slows the display down while seeking and landing, when the controller is
+// doing the most work, and puts it back afterwards.
+//*****************************************************************************
+void updateTaskRates(void)
+{
+    if (flightState == ratesState) {
+        return;
+    }
+    ratesState = flightState;
+
+    Process* display = findProcess(refreshDisplay);
+    if (flightState == SEEKING || flightState == LANDING) {
+        setProcessRate(display, DISPLAY_BUSY_RATE_HZ);
+    } else {
+        setProcessRate(display, DISPLAY_RATE_HZ);
+    }
+}
+
+
+//*****************************************************************************
+// Slows the altitude sampling and the controller down while landed, so the
+// kernel can sleep between tasks, and brings them back to full rate as soon
+// as the helicopter leaves the landed states.
+//*****************************************************************************
+void updatePowerMode(void)
+{
+    bool landed = (flightState == LANDED || flightState == LANDED_LOCK);
+    if (landed == lowPower) {
+        return;
+    }
+    lowPower = landed;
+
+    if (landed) {
+        setAltitudeSampleRate(LANDED_SAMPLE_RATE_HZ);
+        controlPeriod = getTicksPerPeriod(CONTROL_LANDED_RATE_HZ);
+        setForegroundRate(CONTROL_LANDED_RATE_HZ);
+    } else {
+        setAltitudeSampleRate(SAMPLE_RATE_HZ);
+        controlPeriod = getTicksPerPeriod(CONTROL_RATE_HZ);
+        setForegroundRate(CONTROL_RATE_HZ);
+    }
 }
 
 
@@ -231,7 +325,7 @@ void checkControls()
 // Task for sending serial data.
 //*****************************************************************************
 void sendSerialData() {
-    sendData(altitude, desiredAltitude, yaw, desiredYaw, mainDuty, tailDuty, flightState);
+    sendData(altitudeFixed, desiredAltitude, yaw, desiredYaw, mainDuty, tailDuty, flightState);
 }
 
 
@@ -244,11 +338,5 @@ int main(void)
     init();
 
     // Main process
-    Process processes[NUM_TASKS] = {
-         {*runController, KERNEL_MAX_RATE},
-         {*refreshDisplay, 4},
-         {*checkControls, 100},
-         {*sendSerialData, 5}
-    };
-    runKernel(processes, NUM_TASKS);
+    runKernel(tasks, KERNEL_TABLE_SIZE(tasks));
 }
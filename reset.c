@@ -48,7 +48,6 @@ void initReset(void)
 
     // disable interrupts
     GPIOIntDisable(RESET_PORT_BASE, RESET_INT_PIN);
-    GPIOIntDisable(RESET_PORT_BASE, GPIO_INT_PIN_7);
 
     // set it up as an input
     GPIOPinTypeGPIOInput(RESET_PORT_BASE, RESET_PIN);
@@ -69,14 +68,22 @@ void initReset(void)
 
 
 //*****************************************************************************
-// Interrupt handler for soft reset
+// Interrupt handler for soft reset. Port A has one interrupt, so this also
+// passes slider switch edges on to the slider module.
 //*****************************************************************************
 void resetIntHandler(void)
 {
-    // Clear the interrupt
-    GPIOIntClear(RESET_PORT_BASE, RESET_INT_PIN);
-    SysCtlReset();
+    uint32_t status = GPIOIntStatus(RESET_PORT_BASE, true);
 
+    if (status & SW1_PIN) {
+        sliderIntHandler();
+    }
+
+    if (status & RESET_INT_PIN) {
+        // Clear the interrupt
+        GPIOIntClear(RESET_PORT_BASE, RESET_INT_PIN);
+        SysCtlReset();
+    }
 }
 
 
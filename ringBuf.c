@@ -0,0 +1,108 @@
+// *******************************************************
+//
+// ringBuf.c
+//
+// Single producer, single consumer ring buffer of 16-bit
+// samples. Lock-free, so the producer can be an interrupt
+// and the consumer a task without masking interrupts.
+// Entries are kept until read, and writes to a full buffer
+// are dropped and counted, so the reader knows if it fell
+// behind.
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include "ringBuf.h"
+
+
+//*****************************************************************************
+// Initialise the ringBuf instance to use the given storage, which must hold
+// capacity entries. Returns false if capacity is not a power of two.
+//*****************************************************************************
+bool initRingBuf (ringBuf_t *buffer, uint16_t *storage, uint32_t capacity)
+{
+	if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+		return false;
+
+	buffer->data = storage;
+	buffer->mask = capacity - 1;
+	buffer->head = 0;
+	buffer->tail = 0;
+	buffer->overruns = 0;
+	buffer->maxFill = 0;
+	return true;
+}
+
+
+//*****************************************************************************
+// Add an entry. Only called by the producer. Returns false, and counts an
+// overrun, if the buffer is full.
+//*****************************************************************************
+bool writeRingBuf (ringBuf_t *buffer, uint16_t entry)
+{
+	uint32_t head = buffer->head;
+	uint32_t fill = head - buffer->tail;
+	if (fill > buffer->mask) {
+		buffer->overruns++;
+		return false;
+	}
+
+	buffer->data[head & buffer->mask] = entry;
+	RING_BARRIER();		// Entry must land before the consumer can see it
+	buffer->head = head + 1;
+
+	if (fill + 1 > buffer->maxFill)
+		buffer->maxFill = fill + 1;
+	return true;
+}
+
+
+//*****************************************************************************
+// Take the oldest entry. Only called by the consumer. Returns false if the
+// buffer is empty.
+//*****************************************************************************
+bool readRingBuf (ringBuf_t *buffer, uint16_t *entry)
+{
+	uint32_t tail = buffer->tail;
+	if (tail == buffer->head)
+		return false;
+
+	RING_BARRIER();		// Read the entry only after seeing it published
+	*entry = buffer->data[tail & buffer->mask];
+	RING_BARRIER();		// Finish reading before the producer can reuse the slot
+	buffer->tail = tail + 1;
+	return true;
+}
+
+
+//*****************************************************************************
+// Return the number of entries waiting to be read.
+//*****************************************************************************
+uint32_t getRingBufFill (const ringBuf_t *buffer)
+{
+	return buffer->head - buffer->tail;
+}
+
+
+//*****************************************************************************
+// Return the number of writes dropped because the buffer was full.
+//*****************************************************************************
+uint32_t getRingBufOverruns (const ringBuf_t *buffer)
+{
+	return buffer->overruns;
+}
+
+
+//*****************************************************************************
+// Return the most entries that have ever been waiting at once.
+//*****************************************************************************
+uint32_t getRingBufMaxFill (const ringBuf_t *buffer)
+{
+	return buffer->maxFill;
+}
@@ -0,0 +1,57 @@
+#ifndef RINGBUF_H_
+#define RINGBUF_H_
+
+// *******************************************************
+//
+// ringBuf.h
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include <stdint.h>
+#include <stdbool.h>
+
+//*****************************************************************************
+// Memory barrier, so an entry is written before the index that publishes it.
+// On a host only acquire and release ordering is needed between the two
+// threads, which costs nothing on x86.
+//*****************************************************************************
+#if defined(__TI_COMPILER_VERSION__)
+#define RING_BARRIER() __asm(" dmb")
+#elif defined(__arm__)
+#define RING_BARRIER() __asm volatile ("dmb" ::: "memory")
+#else
+#define RING_BARRIER() __atomic_thread_fence(__ATOMIC_ACQ_REL)
+#endif
+
+// *******************************************************
+// Buffer structure. One producer, such as an interrupt, writes and one
+// consumer, such as a task, reads. The indices count every entry ever
+// written and read, and are masked to find the slot.
+typedef struct {
+	uint16_t *data;				// storage, provided by the caller
+	uint32_t mask;				// capacity - 1, capacity is a power of two
+	volatile uint32_t head;		// entries written, only changed by the producer
+	volatile uint32_t tail;		// entries read, only changed by the consumer
+	volatile uint32_t overruns;	// writes dropped because the buffer was full
+	uint32_t maxFill;			// most entries ever waiting, seen by the producer
+} ringBuf_t;
+
+// *******************************************************
+
+//*****************************************************************************
+// Function declarations
+//*****************************************************************************
+bool initRingBuf (ringBuf_t *buffer, uint16_t *storage, uint32_t capacity);
+bool writeRingBuf (ringBuf_t *buffer, uint16_t entry);
+bool readRingBuf (ringBuf_t *buffer, uint16_t *entry);
+uint32_t getRingBufFill (const ringBuf_t *buffer);
+uint32_t getRingBufOverruns (const ringBuf_t *buffer);
+uint32_t getRingBufMaxFill (const ringBuf_t *buffer);
+
+#endif /*RINGBUF_H_*/
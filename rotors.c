@@ -99,8 +99,7 @@ void
 setMainPWM (uint32_t ui32Duty) {
     g_mainDuty = ui32Duty;
     // Calculate the PWM period corresponding to the freq.
-    uint32_t ui32Period =
-        SysCtlClockGet() / PWM_DIVIDER / PWM_RATE_HZ;
+    uint32_t ui32Period = PWM_PERIOD;
 
     PWMGenPeriodSet(PWM_MAIN_BASE, PWM_MAIN_GEN, ui32Period);
     PWMPulseWidthSet(PWM_MAIN_BASE, PWM_MAIN_OUTNUM,
@@ -117,8 +116,7 @@ setTailPWM (uint32_t ui32Duty)
     g_tailDuty = ui32Duty;
 
     // Calculate the PWM period corresponding to the freq.
-    uint32_t ui32Period =
-        SysCtlClockGet() / PWM_DIVIDER / PWM_RATE_HZ;
+    uint32_t ui32Period = PWM_PERIOD;
 
     PWMGenPeriodSet(PWM_TAIL_BASE, PWM_TAIL_GEN, ui32Period);
     PWMPulseWidthSet(PWM_TAIL_BASE, PWM_TAIL_OUTNUM,
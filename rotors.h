@@ -10,6 +10,8 @@
 //
 // *******************************************************
 
+#include "timings.h"
+
 //*****************************************************************************
 // Constants
 //*****************************************************************************
@@ -18,8 +20,15 @@
 
 // PWM configuration
 #define PWM_RATE_HZ  250
+// The PWM clock is kept at 5 MHz, so the period fits the 16-bit counter
+#if SYSTEM_CLOCK_HZ > 20000000
+#define PWM_DIVIDER_CODE   SYSCTL_PWMDIV_16
+#define PWM_DIVIDER        16
+#else
 #define PWM_DIVIDER_CODE   SYSCTL_PWMDIV_4
 #define PWM_DIVIDER        4
+#endif
+#define PWM_PERIOD         (SYSTEM_CLOCK_HZ / PWM_DIVIDER / PWM_RATE_HZ)
 #define PWM_MAIN_DUTY_HIGH 99
 #define PWM_TAIL_DUTY_HIGH 99
 #define PWM_MAIN_DUTY_LOW 1
@@ -28,13 +28,44 @@
 #include "stdlib.h"
 #include "serial.h"
 #include "yaw.h"
+#include "altitude.h"
 #include "flightStates.h"
+#include "kernel.h"
+#include "timings.h"
+#include "trace.h"
+
+
+//********************************************************
+// Ticks taken to send UART_TX_WAIT_CHARS characters of 10 bits each
+//********************************************************
+#define UART_TX_WAIT_TICKS ((SYSTEM_CLOCK_HZ / BAUD_RATE) * 10 * UART_TX_WAIT_CHARS)
+
+//********************************************************
+// Queues a line for sending, yielding the coroutine until it is all in
+// the Tx FIFO. While the FIFO is full it waits for part of it to go out,
+// so the kernel sleeps rather than checking the FIFO every pass. Only one
+// may be used per source line, and only by the coroutine holding the UART.
+//********************************************************
+#define SEND_LINE(task, line) \
+    do { txNext = (line); while (!UARTSendSome()) { TASK_YIELD_FOR(task, UART_TX_WAIT_TICKS); } } while (0)
+
+//********************************************************
+// Yields until no other coroutine is sending, then holds the UART until
+// RELEASE_UART, so the lines of two reports are not mixed together.
+//********************************************************
+#define CLAIM_UART(task) \
+    do { while (txOwner != 0 && txOwner != (task)) { TASK_YIELD_FOR(task, UART_TX_WAIT_TICKS); } txOwner = (task); } while (0)
+#define RELEASE_UART(task) \
+    do { if (txOwner == (task)) { txOwner = 0; } } while (0)
 
 
 //********************************************************
 // Globals to module
 //********************************************************
 char statusStr[MAX_STR_LEN + 1];
+static char* txNext;            // Next character of the line still to be sent
+static TaskState* txOwner = 0;  // Coroutine holding the UART, 0 if it is free
+char statsStr[STATS_STR_LEN + 1];
 
 
 //********************************************************
@@ -54,7 +85,7 @@ void initSerial(void)
     GPIOPinConfigure (GPIO_PA0_U0RX);
     GPIOPinConfigure (GPIO_PA1_U0TX);
 
-    UARTConfigSetExpClk(UART_USB_BASE, SysCtlClockGet(), BAUD_RATE,
+    UARTConfigSetExpClk(UART_USB_BASE, SYSTEM_CLOCK_HZ, BAUD_RATE,
             UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE |
             UART_CONFIG_PAR_NONE);
     UARTFIFOEnable(UART_USB_BASE);
@@ -78,29 +109,225 @@ void UARTSend (char *pucBuffer)
 
 
 //**********************************************************************
-// Transmit the current data values via serial
+// Queue as much of the pending string into the UART Tx FIFO as will fit,
+// without blocking. Returns true once the whole string has been queued.
+//**********************************************************************
+static bool UARTSendSome (void)
+{
+    while (*txNext)
+    {
+        if (!UARTCharPutNonBlocking(UART_USB_BASE, *txNext)) {
+            return false;
+        }
+        txNext++;
+    }
+    return true;
+}
+
+
+//**********************************************************************
+// Returns the first request received over serial, TRACE_REQUEST_CHAR or
+// RECORD_REQUEST_CHAR, or 0 if there is none. Anything else received is
+// dropped.
+//**********************************************************************
+static char getRequest (void)
+{
+    while (UARTCharsAvail(UART_USB_BASE))
+    {
+        char received = UARTCharGetNonBlocking(UART_USB_BASE);
+        if (received == RECORD_REQUEST_CHAR) {
+            return received;
+        }
+#if TRACE_ENABLED
+        if (received == TRACE_REQUEST_CHAR) {
+            return received;
+        }
+#endif
+    }
+    return 0;
+}
+
+
+//**********************************************************************
+// Transmit the current data values via serial. Runs as a kernel
+// coroutine, yielding whenever the Tx FIFO is full rather than waiting
+// on the UART, so it holds the CPU for at most one FIFO fill at a time.
+// The values are copied on the first call so every line of an update
+// is from the same moment; arguments passed while resuming are ignored.
+// If the trace has been asked for it is sent instead, with recording
+// paused until it has all gone. tools/traceToChrome.py reads it.
+// If a recording of the raw altitude samples has been asked for, it is
+// sent instead as they are taken, one per line, until the recording
+// buffer has filled and all been sent.
+// The actual altitude is in 1/ALTITUDE_FRAC_SCALE of a percent, the
+// desired altitude in whole percent.
 //**********************************************************************
 void sendData(int32_t actualAltitude, int32_t desiredAltitude, uint32_t actualYaw,
               uint32_t desiredYaw, uint32_t mainDuty, uint32_t tailDuty, uint8_t state)
 {
+    static TaskState task;
+    static int32_t sentAltitude, sentDesiredAltitude;
+    static uint32_t sentYaw, sentDesiredYaw, sentMainDuty, sentTailDuty;
+    static uint8_t sentState;
+    static char request;
+    static uint16_t recorded;
+    static bool recording;
+#if TRACE_ENABLED
+    static uint32_t traceIndex;
+#endif
+
+    TASK_BEGIN(&task);
+    CLAIM_UART(&task);
+    request = getRequest();
+
+    if (request == RECORD_REQUEST_CHAR && startAltitudeRecording()) {
+        usprintf(statusStr, "SAMPLES %u\n\r", getAltitudeRecordRate());
+        SEND_LINE(&task, statusStr);
+
+        // Check if it is still recording before reading, so the last
+        // samples are not missed
+        for (;;) {
+            recording = isAltitudeRecording();
+            if (readAltitudeRecording(&recorded)) {
+                usprintf(statusStr, "%u\n\r", recorded);
+                SEND_LINE(&task, statusStr);
+            } else if (recording) {
+                TASK_YIELD_FOR(&task, UART_TX_WAIT_TICKS);
+            } else {
+                break;
+            }
+        }
+        usprintf(statusStr, "END\n\r");
+        SEND_LINE(&task, statusStr);
+
+        RELEASE_UART(&task);
+        TASK_EXIT(&task);
+    }
+
+#if TRACE_ENABLED
+    if (request == TRACE_REQUEST_CHAR) {
+        pauseTrace(true);
+
+        // Header with the tick rate, then the name of each process
+        usprintf(statusStr, "TRACE %u %u\n\r", SYSTEM_CLOCK_HZ, getTraceCount());
+        SEND_LINE(&task, statusStr);
+        for (traceIndex = 0; traceIndex < getNumProcesses(); traceIndex++) {
+            usnprintf(statusStr, sizeof(statusStr), "N %u %s\n\r",
+                      TRACE_ID_TASK + traceIndex, getProcessName(traceIndex));
+            SEND_LINE(&task, statusStr);
+        }
+
+        // Then every event, oldest first
+        for (traceIndex = 0; traceIndex < getTraceCount(); traceIndex++) {
+            TraceEntry entry = getTraceEntry(traceIndex);
+            usprintf(statusStr, "%c %u %u\n\r", entry.kind, entry.id, entry.time);
+            SEND_LINE(&task, statusStr);
+        }
+        usprintf(statusStr, "END\n\r");
+        SEND_LINE(&task, statusStr);
+
+        pauseTrace(false);
+        RELEASE_UART(&task);
+        TASK_EXIT(&task);
+    }
+#endif
+
+    sentAltitude = actualAltitude;
+    sentDesiredAltitude = desiredAltitude;
+    sentYaw = actualYaw;
+    sentDesiredYaw = desiredYaw;
+    sentMainDuty = mainDuty;
+    sentTailDuty = tailDuty;
+    sentState = state;
+
     // Send a newline
     usprintf(statusStr, "-----------------\n\r");
-    UARTSend (statusStr);
+    SEND_LINE(&task, statusStr);
 
     // Send yaw
-    usprintf (statusStr, "Yaw: %3d  [%3d] \n\r", actualYaw, desiredYaw);
-    UARTSend (statusStr);
+    usprintf (statusStr, "Yaw: %3d  [%3d] \n\r", sentYaw, sentDesiredYaw);
+    SEND_LINE(&task, statusStr);
 
-    // Send altitude
-    usprintf(statusStr, "Alt: %3d%% [%3d]\n\r", actualAltitude, desiredAltitude);
-    UARTSend (statusStr);
+    // Send altitude, to the fixed point resolution the controller uses
+    usprintf(statusStr, "Alt: %s%d.%02d%% [%3d]\n\r", (sentAltitude < 0) ? "-" : "",
+             abs(sentAltitude) / ALTITUDE_FRAC_SCALE, abs(sentAltitude) % ALTITUDE_FRAC_SCALE,
+             sentDesiredAltitude);
+    SEND_LINE(&task, statusStr);
 
     // Send main duty cycle
-    usprintf(statusStr, "M: %3d%% T: %3d%% \n\r", mainDuty, tailDuty);
-    UARTSend (statusStr);
+    usprintf(statusStr, "M: %3d%% T: %3d%% \n\r", sentMainDuty, sentTailDuty);
+    SEND_LINE(&task, statusStr);
 
     // Send tail duty cycle
-    usprintf(statusStr, "Mode: %s\n\r", getStateStr(state));
-    UARTSend (statusStr);
+    usprintf(statusStr, "Mode: %s\n\r", getStateStr(sentState));
+    SEND_LINE(&task, statusStr);
+
+    RELEASE_UART(&task);
+    TASK_END(&task);
 }
 
+
+//**********************************************************************
+// Transmit how the landed calibration went via serial: how long it took,
+// the landed ADC value, and the noise as a variance in ADC steps squared.
+//**********************************************************************
+void sendCalibration(void)
+{
+    CalibrationStats calibration = getCalibrationStats();
+    usnprintf(statsStr, sizeof(statsStr), "Calibrated in %u us, %u tries%s, landed %u, variance %u.%02u\n\r",
+              TICKS_TO_US(calibration.time), calibration.attempts,
+              calibration.timedOut ? " (timed out)" : (calibration.settled ? "" : " (noisy)"),
+              calibration.landed, calibration.variance / 100, calibration.variance % 100);
+    UARTSend (statsStr);
+}
+
+
+//**********************************************************************
+// Transmit the timing statistics of each kernel process via serial.
+// Execution times and start intervals are in cycles, start latencies are
+// in timer ticks. For the controller the start latency plus the execution
+// time bounds the sensor-to-PWM latency, and the interval spread is the
+// period jitter. Runs as a kernel coroutine like sendData, so sending the
+// report does not hold up the processes it is measuring.
+//**********************************************************************
+void sendKernelStats(void)
+{
+    static TaskState task;
+    static int i;
+
+    TASK_BEGIN(&task);
+    CLAIM_UART(&task);
+
+    usprintf(statsStr, "name n exec(min/mean/max) late(min/max) miss period(min/max) skip/catchup/reanchor resp\n\r");
+    SEND_LINE(&task, statsStr);
+
+    for (i = 0; i < getNumProcesses(); i++) {
+        ProcessStats stats = getProcessStats(i);
+        usnprintf(statsStr, sizeof(statsStr), "%s %u %u/%u/%u %u/%u %u %u/%u %u/%u/%u %u\n\r",
+                  getProcessName(i), stats.runCount, stats.minExecTime,
+                  getProcessMeanExecTime(i), stats.maxExecTime,
+                  stats.minStartLatency, stats.maxStartLatency, stats.missedPeriods,
+                  stats.minInterval, stats.maxInterval, stats.skippedReleases,
+                  stats.catchUpRuns, stats.reanchors, stats.maxResponseTime);
+        SEND_LINE(&task, statsStr);
+    }
+
+    SchedulerStats scheduler = getSchedulerStats();
+    uint32_t meanOverhead = (scheduler.passCount == 0) ? 0 : (scheduler.totalOverhead / scheduler.passCount);
+    uint32_t load = getUtilisation();
+    usnprintf(statsStr, sizeof(statsStr), "sched %u passes, overhead mean/max %u/%u, load %u.%u%%%s\n\r",
+              scheduler.passCount, meanOverhead, scheduler.maxOverhead, load / 10, load % 10,
+              isShedding() ? " shedding" : "");
+    SEND_LINE(&task, statsStr);
+
+    // Time asleep in each flight state, in tenths of a percent
+    for (i = 0; i < KERNEL_IDLE_CONTEXTS; i++) {
+        uint32_t permille = getIdlePermille(i);
+        usnprintf(statsStr, sizeof(statsStr), "state %u %s asleep %u.%u%%\n\r",
+                  i, getStateStr(i), permille / 10, permille % 10);
+        SEND_LINE(&task, statsStr);
+    }
+
+    RELEASE_UART(&task);
+    TASK_END(&task);
+}
@@ -14,9 +14,11 @@
 // Constants
 //********************************************************
 #define SLOWTICK_RATE_HZ 4
-#define MAX_STR_LEN 16
+#define MAX_STR_LEN 24
+#define STATS_STR_LEN 160
 //---USB Serial comms: UART0, Rx:PA0 , Tx:PA1
 #define BAUD_RATE 9600
+#define UART_TX_WAIT_CHARS 8        // Characters let out of the Tx FIFO before filling it again
 #define UART_USB_BASE           UART0_BASE
 #define UART_USB_PERIPH_UART    SYSCTL_PERIPH_UART0
 #define UART_USB_PERIPH_GPIO    SYSCTL_PERIPH_GPIOA
@@ -32,6 +34,8 @@ void initSerial(void);
 void UARTSend(char *pucBuffer);
 void sendData(int32_t actualAltitude, int32_t desiredAltitude, uint32_t actualYaw,
               uint32_t desiredYaw, uint32_t mainDuty, uint32_t tailDuty, uint8_t state);
+void sendKernelStats(void);
+void sendCalibration(void);
 
 
 #endif /* SERIAL_H_ */
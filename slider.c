@@ -19,6 +19,7 @@
 #include "driverlib/gpio.h"
 #include "driverlib/sysctl.h"
 #include "driverlib/debug.h"
+#include "events.h"
 
 
 //*****************************************************************************
@@ -26,6 +27,7 @@
 //*****************************************************************************
 #define SW1_PERIPH  SYSCTL_PERIPH_GPIOA
 #define SW1_PORT_BASE  GPIO_PORTA_BASE
+#define SW1_INT_PIN GPIO_INT_PIN_7
 
 
 //*****************************************************************************
@@ -63,3 +65,26 @@ bool getSliderState()
     return state;
 }
 
+
+//*****************************************************************************
+// Enables an interrupt on both edges of the slider switch. Port A shares one
+// interrupt with the reset pin, so the handler is registered by initReset
+// and calls sliderIntHandler when the slider pin is flagged.
+//*****************************************************************************
+void enableSliderInterrupt(void)
+{
+    GPIOIntTypeSet (SW1_PORT_BASE, SW1_PIN, GPIO_BOTH_EDGES);
+    GPIOIntEnable (SW1_PORT_BASE, SW1_INT_PIN);
+}
+
+
+//*****************************************************************************
+// Handles an edge on the slider switch. Updates the state straight away and
+// lets the kernel know, so a sleeping board reacts to the switch at once.
+//*****************************************************************************
+void sliderIntHandler(void)
+{
+    GPIOIntClear (SW1_PORT_BASE, SW1_INT_PIN);
+    updateSlider();
+    postEvent(EVENT_SLIDER_EDGE);
+}
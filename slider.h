@@ -30,6 +30,8 @@ enum sliderStates {SLIDER_DOWN = 0, SLIDER_UP};
 // Function declarations
 //*****************************************************************************
 void initSlider(void);
+void enableSliderInterrupt(void);
+void sliderIntHandler(void);
 void updateSlider();
 bool getSliderState();
 
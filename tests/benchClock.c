@@ -0,0 +1,135 @@
+// *******************************************************
+//
+// benchClock.c
+//
+// Host test and benchmark of the time base in timings.c,
+// built as for the board against the stand-in registers
+// in stubs, not the virtual timings. Moves the DWT cycle
+// count on by steps up to a whole wrap and checks the
+// 64-bit time extended from it always matches a reference
+// count. Then times a read of the clock against the old
+// WTIMER5 read, TimerValueGet64 counting down plus the
+// subtraction every caller made. Both paths are timed on
+// the host registers, so they compare the work done per
+// read; on the board each WTIMER5 read also waits on the
+// peripheral bus, and it takes two or three of them.
+// Exits with 1 if the time is ever wrong.
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include <stdio.h>
+#include <time.h>
+#include "timings.h"
+
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#define DWT_CYCCNT_R HWREG(0xE0001004)      // As in timings.c
+#define TIMING_BASE WTIMER5_BASE            // The old time base
+#define TIMING_MAX_64 0xFFFFFFFFFFFFFFFFull
+#define CLOCK_WRAPS 1000                    // Wraps of the cycle count checked
+#define BENCH_READS 20000000
+
+// Steps the cycle count is moved on by in turn, up to one short of a wrap,
+// the most that can pass between two reads of the clock
+static const uint32_t g_steps[] = {1, 7, 1000, 123456789, 0x7FFFFFFF, 0x80000001, 0xFFFFFFFF};
+
+
+//*****************************************************************************
+// Globals to module
+//*****************************************************************************
+static volatile uint64_t g_sink;    // Keeps the benchmark results from being optimised out
+
+
+static double hostSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+//*****************************************************************************
+// Moves the cycle count on past CLOCK_WRAPS wraps, reading the clock after
+// each step. Returns the number of reads that did not match the reference.
+//*****************************************************************************
+static uint32_t checkClock(void)
+{
+    uint64_t reference = 0;
+    uint32_t wrong = 0;
+    uint32_t reads = 0;
+    uint32_t i = 0;
+
+    initTimer();
+    while (reference < ((uint64_t) CLOCK_WRAPS << 32)) {
+        reference += g_steps[i];
+        DWT_CYCCNT_R = (uint32_t) reference;
+        if (getCurTime() != reference || getCurTicks() != (uint32_t) reference || isHostMasked()) {
+            wrong++;
+        }
+        reads++;
+        i = (i + 1) % (sizeof(g_steps) / sizeof(g_steps[0]));
+    }
+    printf("clock: %u reads over %u wraps of the cycle count, %u wrong\n", reads, CLOCK_WRAPS, wrong);
+    return wrong;
+}
+
+
+//*****************************************************************************
+// Times each way of reading the time, with the counters moving on between
+// reads, in ns per read on this host.
+//*****************************************************************************
+static void benchmark(void)
+{
+    uint32_t i;
+    uint64_t past = 0;
+
+    initTimer();
+    double start = hostSeconds();
+    for (i = 0; i < BENCH_READS; i++) {
+        DWT_CYCCNT_R += 40;
+        g_sink = getCurTicks();
+    }
+    double ticks = hostSeconds() - start;
+
+    start = hostSeconds();
+    for (i = 0; i < BENCH_READS; i++) {
+        DWT_CYCCNT_R += 40;
+        g_sink = getCurTime() - past;
+    }
+    double time = hostSeconds() - start;
+
+    // The old clock counted down from TIMING_MAX_64, so elapsed times were
+    // the past time less the current one
+    TimerLoadSet64(TIMING_BASE, TIMING_MAX_64);
+    HWREG(TIMING_BASE + TIMER_O_TBV) = 0xFFFFFFFF;
+    HWREG(TIMING_BASE + TIMER_O_TAV) = 0xFFFFFFFF;
+    past = TIMING_MAX_64;
+    start = hostSeconds();
+    for (i = 0; i < BENCH_READS; i++) {
+        HWREG(TIMING_BASE + TIMER_O_TAV) -= 40;
+        g_sink = past - TimerValueGet64(TIMING_BASE);
+    }
+    double wtimer = hostSeconds() - start;
+
+    printf("ns per read: getCurTicks %.2f, getCurTime %.2f, WTIMER5 %.2f\n",
+           ticks * 1e9 / BENCH_READS, time * 1e9 / BENCH_READS, wtimer * 1e9 / BENCH_READS);
+}
+
+
+int main(void)
+{
+    uint32_t wrong = checkClock();
+    benchmark();
+
+    printf("benchClock: %s\n", wrong ? "FAILED" : "ok");
+    return wrong ? 1 : 0;
+}
@@ -0,0 +1,286 @@
+// *******************************************************
+//
+// benchFilters.c
+//
+// Host benchmark of the altitude filters in filters.c.
+// For each filter it reports the time taken per sample
+// and per output on this host, the group delay of a step
+// in samples, and how much it takes the noise out of a
+// trace, as the ratio of the standard deviations in dB and
+// the largest error left. The trace is a steady altitude
+// with Gaussian noise and single-sample spikes, or a
+// recording taken over serial with RECORD_REQUEST_CHAR,
+// which is put through the decimator as on the board.
+// Exits with 1 if a filter does not delay a step by the
+// number of samples it should, or adds noise.
+//
+//     benchFilters [-f recording]
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include "filters.h"
+#include "cic.h"
+#include "altitude.h"
+
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#define TRACE_MAX 200000            // Most samples in a trace
+#define TRACE_LEVEL 2000            // Steady ADC value of the synthetic trace
+#define TRACE_NOISE 8.0             // Standard deviation of its noise, in ADC steps
+#define TRACE_SPIKE_EVERY 200       // Samples between spikes, on average
+#define TRACE_SPIKE 400             // Size of each spike, in ADC steps
+#define STEP_LOW 1000               // Step the group delay is measured on
+#define STEP_HIGH 2000
+#define STEP_SETTLE 256             // Samples before the step, and skipped before measuring noise
+#define TIMING_PASSES 10            // Times the trace is put through for the timing
+
+static const char* g_filterNames[NUM_FILTERS] = {
+    "boxcar", "ema", "fir", "median", "median+boxcar"
+};
+
+// Samples a step should take to get half way through each filter
+static const int32_t g_expectedDelays[NUM_FILTERS] = {
+    (BOXCAR_SIZE - 1) / 2,
+    5,                              // EMA with EMA_SHIFT 3: 1 - (7/8)^6 > 1/2
+    (FIR_TAPS - 1) / 2,
+    MEDIAN_SIZE / 2,
+    MEDIAN_SIZE / 2 + (BOXCAR_SIZE - 1) / 2
+};
+
+
+//*****************************************************************************
+// Globals to module
+//*****************************************************************************
+static uint16_t g_trace[TRACE_MAX];
+static uint32_t g_traceLength = 0;
+static volatile uint32_t g_sink;    // Keeps the outputs from being optimised out
+
+
+static double hostSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+//*****************************************************************************
+// Returns a sample of Gaussian noise with the given standard deviation.
+//*****************************************************************************
+static double gaussian(double deviation)
+{
+    double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return deviation * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+
+//*****************************************************************************
+// Makes the synthetic trace: a steady altitude with noise and spikes.
+//*****************************************************************************
+static void makeTrace(void)
+{
+    uint32_t i;
+
+    srand(361);
+    for (i = 0; i < TRACE_MAX; i++) {
+        double sample = TRACE_LEVEL + gaussian(TRACE_NOISE);
+        if (rand() % TRACE_SPIKE_EVERY == 0) {
+            sample += (rand() % 2) ? TRACE_SPIKE : -TRACE_SPIKE;
+        }
+        g_trace[i] = (uint16_t) lround(sample);
+    }
+    g_traceLength = TRACE_MAX;
+}
+
+
+//*****************************************************************************
+// Reads a recording as sent by sendData: a "SAMPLES rate" line, one raw
+// sample per line, then "END". The raw samples are decimated as the altitude
+// module does before they reach the filter. Returns false if the file cannot
+// be read or has too few samples.
+//*****************************************************************************
+static bool readRecording(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    char line[64];
+    unsigned rate = 0;
+    CicDecimator cic;
+    uint32_t raw = 0;
+
+    if (file == 0) {
+        return false;
+    }
+    initCic(&cic, CIC_ORDER, CIC_RATIO_SHIFT, 0);
+    while (fgets(line, sizeof(line), file) && g_traceLength < TRACE_MAX) {
+        unsigned sample;
+        if (sscanf(line, "SAMPLES %u", &rate) == 1 || sscanf(line, "%u", &sample) != 1) {
+            if (strncmp(line, "END", 3) == 0) {
+                break;
+            }
+            continue;
+        }
+        uint32_t decimated = sample;
+        raw++;
+        if (CIC_RATIO_SHIFT == 0 || cicSample(&cic, sample, &decimated)) {
+            g_trace[g_traceLength++] = decimated;
+        }
+    }
+    fclose(file);
+    printf("%s: %u raw samples at %u Hz, %u after the decimator\n", path, raw, rate, g_traceLength);
+    return g_traceLength > 2 * STEP_SETTLE;
+}
+
+
+//*****************************************************************************
+// Returns the samples a step takes to get half way through the filter.
+//*****************************************************************************
+static int32_t measureDelay(uint8_t type)
+{
+    int32_t i;
+
+    setFilter(type);
+    for (i = 0; i < STEP_SETTLE; i++) {
+        filterSample(STEP_LOW);
+    }
+    for (i = 0; i < STEP_SETTLE; i++) {
+        filterSample(STEP_HIGH);
+        updateFilterOutput();
+        if (getFilterOutput() >= (STEP_LOW + STEP_HIGH) / 2) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+//*****************************************************************************
+// Puts the trace through the filter, and works out the standard deviation
+// of what goes in and what comes out, and the largest error coming out,
+// against the mean of the trace. The filter is given time to settle first.
+//*****************************************************************************
+static void measureNoise(uint8_t type, double* inDeviation, double* outDeviation, double* outPeak)
+{
+    double inSum = 0, inSquares = 0, outSum = 0, outSquares = 0;
+    double mean;
+    uint32_t n = g_traceLength - STEP_SETTLE;
+    uint32_t i;
+
+    setFilter(type);
+    for (i = 0; i < g_traceLength; i++) {
+        filterSample(g_trace[i]);
+        updateFilterOutput();
+        if (i >= STEP_SETTLE) {
+            double in = g_trace[i];
+            double out = getFilterOutput();
+            inSum += in;
+            inSquares += in * in;
+            outSum += out;
+            outSquares += out * out;
+        }
+    }
+    mean = inSum / n;
+    *inDeviation = sqrt(inSquares / n - mean * mean);
+    *outDeviation = sqrt(fmax(outSquares / n - (outSum / n) * (outSum / n), 0.0));
+
+    // Once more for the largest error, now the mean is known
+    *outPeak = 0;
+    setFilter(type);
+    for (i = 0; i < g_traceLength; i++) {
+        filterSample(g_trace[i]);
+        updateFilterOutput();
+        if (i >= STEP_SETTLE) {
+            *outPeak = fmax(*outPeak, fabs(getFilterOutput() - mean));
+        }
+    }
+}
+
+
+//*****************************************************************************
+// Times adding each sample, and working out the output, in ns on this host.
+//*****************************************************************************
+static void measureCost(uint8_t type, double* perSample, double* perOutput)
+{
+    uint32_t pass, i;
+
+    setFilter(type);
+    double start = hostSeconds();
+    for (pass = 0; pass < TIMING_PASSES; pass++) {
+        for (i = 0; i < g_traceLength; i++) {
+            filterSample(g_trace[i]);
+        }
+    }
+    *perSample = (hostSeconds() - start) * 1e9 / ((double) TIMING_PASSES * g_traceLength);
+
+    start = hostSeconds();
+    for (pass = 0; pass < TIMING_PASSES; pass++) {
+        for (i = 0; i < g_traceLength; i++) {
+            updateFilterOutput();
+            g_sink = getFilterOutput();
+        }
+    }
+    *perOutput = (hostSeconds() - start) * 1e9 / ((double) TIMING_PASSES * g_traceLength);
+}
+
+
+int main(int argc, char* argv[])
+{
+    const char* recording = 0;
+    bool ok = true;
+    int option;
+    uint8_t type;
+
+    while ((option = getopt(argc, argv, "f:")) != -1) {
+        switch (option)
+        {
+            case 'f': recording = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-f recording]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (recording == 0) {
+        makeTrace();
+        printf("synthetic trace: %u samples, noise %.1f steps, a %u step spike every %u samples\n",
+               g_traceLength, TRACE_NOISE, TRACE_SPIKE, TRACE_SPIKE_EVERY);
+    } else if (!readRecording(recording)) {
+        fprintf(stderr, "%s: could not read enough samples\n", recording);
+        return 2;
+    }
+
+    printf("%-14s %10s %10s %8s %10s %10s\n", "filter", "add(ns)", "output(ns)", "delay",
+           "noise(dB)", "peak");
+    for (type = 0; type < NUM_FILTERS; type++) {
+        double perSample, perOutput, inDeviation, outDeviation, outPeak;
+        int32_t delay = measureDelay(type);
+        measureNoise(type, &inDeviation, &outDeviation, &outPeak);
+        measureCost(type, &perSample, &perOutput);
+        double attenuation = (outDeviation == 0) ? INFINITY : 20 * log10(inDeviation / outDeviation);
+        bool filterOk = (delay == g_expectedDelays[type]) && (attenuation > 0);
+
+        printf("%-14s %10.2f %10.2f %8d %10.1f %10.1f%s\n", g_filterNames[type], perSample, perOutput,
+               delay, attenuation, outPeak, filterOk ? "" : "  FAILED");
+        if (!filterOk) {
+            ok = false;
+        }
+    }
+
+    printf("benchFilters: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
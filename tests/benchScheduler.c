@@ -0,0 +1,221 @@
+// *******************************************************
+//
+// benchScheduler.c
+//
+// Host benchmark of a kernel.c scheduler pass against the
+// virtual timings, with 5, 10 and 20 periodic tasks that
+// do no work, so only the scheduler is timed. Each is run
+// for BENCH_SECONDS of simulated time and compared with
+// the original round robin loop, which read the 64-bit
+// WTIMER5 and divided the clock rate by the task rate for
+// every task on every pass. Reports passes per simulated
+// second, host ns per pass and host us per simulated
+// second, and exits with 1 if a task was not run at its
+// rate. The cycles a pass takes on the board are in the
+// scheduler line of the serial statistics.
+//
+// Build with -DKERNEL_IDLE_SLEEP=0 to time the polling
+// pass instead of the deadline pass. See the Makefile.
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include <stdio.h>
+#include <time.h>
+#include "inc/hw_memmap.h"
+#include "inc/hw_types.h"
+#include "driverlib/timer.h"
+#include "kernel.h"
+#include "timings.h"
+
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#define BENCH_SECONDS 20                // Simulated time each table is run for
+#define SIM_PASS_TICKS US_TO_TICKS(2)   // Cost of a scheduler pass on the board, as in kernelSim
+#define OLD_TIMING_BASE WTIMER5_BASE    // The original time base, counting down
+#define OLD_TIMING_MAX_64 0xFFFFFFFFFFFFFFFFull
+#define MAX_TASKS 20
+
+static const int g_sizes[] = {5, 10, 20};   // Tasks in each table timed
+
+
+//*****************************************************************************
+// Globals to module
+//*****************************************************************************
+static uint32_t g_runs = 0;
+static volatile uint32_t g_clockRate;   // Run time clock rate, as the original read it
+
+static void idleTask(void)
+{
+    g_runs++;
+}
+
+static Process g_tasks[MAX_TASKS] = {
+    KERNEL_TASK(idleTask, 1000, "t1000", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_HIGH),
+    KERNEL_TASK(idleTask, 500, "t500", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_NORMAL),
+    KERNEL_TASK(idleTask, 250, "t250", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_NORMAL),
+    KERNEL_TASK(idleTask, 200, "t200", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_NORMAL),
+    KERNEL_TASK(idleTask, 100, "t100", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_NORMAL),
+    KERNEL_TASK(idleTask, 50, "t50", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_NORMAL),
+    KERNEL_TASK(idleTask, 40, "t40", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_NORMAL),
+    KERNEL_TASK(idleTask, 25, "t25", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_NORMAL),
+    KERNEL_TASK(idleTask, 20, "t20", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_NORMAL),
+    KERNEL_TASK(idleTask, 10, "t10", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_LOW),
+    KERNEL_TASK(idleTask, 8, "t8", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_LOW),
+    KERNEL_TASK(idleTask, 5, "t5", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_LOW),
+    KERNEL_TASK(idleTask, 4, "t4", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_LOW),
+    KERNEL_TASK(idleTask, 400, "t400", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_NORMAL),
+    KERNEL_TASK(idleTask, 125, "t125", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_NORMAL),
+    KERNEL_TASK(idleTask, 80, "t80", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_NORMAL),
+    KERNEL_TASK(idleTask, 16, "t16", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_LOW),
+    KERNEL_TASK(idleTask, 2, "t2", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_LOW),
+    KERNEL_TASK(idleTask, 1, "t1", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_LOW),
+    KERNEL_TASK(idleTask, 320, "t320", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_NORMAL)
+};
+
+// The process of the original kernel
+typedef struct {
+    void (*handler)(void);
+    uint32_t rate;
+    uint64_t lastRunRef;
+} OldProcess;
+
+static OldProcess g_oldTasks[MAX_TASKS];
+
+
+static double hostSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+//*****************************************************************************
+// Returns the runs every task in the first n should have made over the
+// simulated time, at its rate.
+//*****************************************************************************
+static uint32_t expectedRuns(int n)
+{
+    uint32_t runs = 0;
+    int i;
+    for (i = 0; i < n; i++) {
+        runs += g_tasks[i].rate * BENCH_SECONDS;
+    }
+    return runs;
+}
+
+
+//*****************************************************************************
+// The original pass, as kernel.c and timings.c first had it, on the host
+// registers of the original timer.
+//*****************************************************************************
+static bool oldShouldBeRun(uint64_t lastRun, uint32_t rate)
+{
+    uint64_t current = TimerValueGet64(OLD_TIMING_BASE);
+    return ((lastRun - current) > (g_clockRate / rate));
+}
+
+static void runOldPass(OldProcess processes[], int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        if (processes[i].lastRunRef == 0 || oldShouldBeRun(processes[i].lastRunRef, processes[i].rate)) {
+            processes[i].lastRunRef = TimerValueGet64(OLD_TIMING_BASE);
+            processes[i].handler();
+        }
+    }
+}
+
+
+//*****************************************************************************
+// Times the original loop over the first n tasks, moving its timer down by
+// the cost of a pass after each one.
+//*****************************************************************************
+static void benchOld(int n)
+{
+    uint64_t passes = 0;
+    uint64_t left = (uint64_t) BENCH_SECONDS * SYSTEM_CLOCK_HZ;
+    int i;
+
+    g_clockRate = SYSTEM_CLOCK_HZ;
+    for (i = 0; i < n; i++) {
+        g_oldTasks[i].handler = idleTask;
+        g_oldTasks[i].rate = g_tasks[i].rate;
+        g_oldTasks[i].lastRunRef = 0;
+    }
+    TimerLoadSet64(OLD_TIMING_BASE, OLD_TIMING_MAX_64);
+    HWREG(OLD_TIMING_BASE + TIMER_O_TBV) = 0xFFFFFFFF;
+    HWREG(OLD_TIMING_BASE + TIMER_O_TAV) = 0xFFFFFFFF;
+    g_runs = 0;
+
+    double start = hostSeconds();
+    while (left >= SIM_PASS_TICKS) {
+        runOldPass(g_oldTasks, n);
+        HWREG(OLD_TIMING_BASE + TIMER_O_TAV) -= SIM_PASS_TICKS;
+        left -= SIM_PASS_TICKS;
+        passes++;
+    }
+    double seconds = hostSeconds() - start;
+
+    printf("%5d %-9s %10llu %10.1f %12.1f %10u\n", n, "original",
+           (unsigned long long) (passes / BENCH_SECONDS), seconds * 1e9 / passes,
+           seconds * 1e6 / BENCH_SECONDS, g_runs / BENCH_SECONDS);
+}
+
+
+//*****************************************************************************
+// Times the kernel's own pass over the first n tasks. The deadline pass
+// moves virtual time on itself by sleeping; both are charged the cost of a
+// pass on top. Returns false if the tasks were not run at their rates.
+//*****************************************************************************
+static bool benchKernel(int n)
+{
+    uint64_t passes = 0;
+    uint64_t end;
+
+    initTimer();
+    initKernel(g_tasks, n);
+    end = getCurTime() + (uint64_t) BENCH_SECONDS * SYSTEM_CLOCK_HZ;
+    g_runs = 0;
+
+    double start = hostSeconds();
+    while (getCurTime() < end) {
+        runKernelPass();
+        advanceVirtualTime(SIM_PASS_TICKS);
+        passes++;
+    }
+    double seconds = hostSeconds() - start;
+
+    printf("%5d %-9s %10llu %10.1f %12.1f %10u\n", n, KERNEL_IDLE_SLEEP ? "deadline" : "polling",
+           (unsigned long long) (passes / BENCH_SECONDS), seconds * 1e9 / passes,
+           seconds * 1e6 / BENCH_SECONDS, g_runs / BENCH_SECONDS);
+
+    // Every task should have run at its rate, give or take one release
+    return g_runs + n >= expectedRuns(n) && g_runs <= expectedRuns(n) + n;
+}
+
+
+int main(void)
+{
+    bool ok = true;
+    unsigned i;
+
+    printf("%5s %-9s %10s %10s %12s %10s\n", "tasks", "pass", "passes/s", "ns/pass",
+           "host us/s", "runs/s");
+    for (i = 0; i < sizeof(g_sizes) / sizeof(g_sizes[0]); i++) {
+        benchOld(g_sizes[i]);
+        ok = benchKernel(g_sizes[i]) && ok;
+    }
+
+    printf("benchScheduler: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,317 @@
+// *******************************************************
+//
+// kernelSim.c
+//
+// Runs kernel.c on a Linux host against the virtual
+// timings, with a task mix like the one in main.c. Each
+// task moves virtual time on by a synthetic cost, so hours
+// of flight can be simulated in seconds. The ADC interrupt
+// at the end of each uDMA block is modelled too, and every
+// interrupt is entered up to the given jitter late.
+// Reports the release jitter, response time, missed
+// periods and CPU utilisation of every task, and the time
+// from an altitude sample being taken to the PWM the
+// controller sets from it. Exits with 1 if any task missed
+// a period or took longer than its period to respond, so
+// it can be used to check scheduler changes.
+//
+//     kernelSim [-t seconds] [-s serialHz] [-j jitterUs] [-q]
+//
+// Build with -DKERNEL_IDLE_SLEEP=0 to run the polling
+// pass instead of the deadline pass, and with
+// -DCONTROL_FOREGROUND=0 to run the controller on each
+// ADC block instead of from the timer. See the Makefile.
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include "kernel.h"
+#include "timings.h"
+#include "events.h"
+#include "altitude.h"
+
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#define SIM_SECONDS 3600            // Simulated time to run for by default
+#define SIM_PASS_TICKS US_TO_TICKS(2)   // Cost of a scheduler pass on the board
+#define SIM_ISR_JITTER_US 10        // Most an interrupt is entered late by, by default
+#ifndef CONTROL_FOREGROUND
+#define CONTROL_FOREGROUND 1        // 1 to run the controller from the timer, as in main.c
+#endif
+#define CONTROL_RATE_HZ 1000
+#define CONTROL_COST_US 40
+#define CONTROLS_RATE_HZ 50
+#define CONTROLS_COST_US 15
+#define DISPLAY_RATE_HZ 4
+#define DISPLAY_LINE_COST_US 600    // Each of the four lines, one per pass
+#define SERIAL_RATE_HZ 5
+#define SERIAL_LINE_CHARS 20        // Characters in each of the five lines
+#define SERIAL_CHAR_COST_US 2       // Putting one character in the Tx FIFO
+#define UART_FIFO_CHARS 16
+#define UART_CHAR_TICKS ((SYSTEM_CLOCK_HZ / 9600) * 10)
+#define BUTTON_EVENT_PERIOD 997     // Controller runs between simulated button edges
+#define ADC_BLOCK_TICKS ((SYSTEM_CLOCK_HZ / (SAMPLE_RATE_HZ * CIC_DECIMATION)) * ADC_DMA_BLOCK_SIZE)
+#define ADC_INT_COST_US 2           // Re-arming the uDMA and posting the block
+#define ADC_BLOCK_COST_US 50        // Decimating and filtering one block in the altitude task
+
+
+//*****************************************************************************
+// Globals to module
+//*****************************************************************************
+static uint32_t g_controlRuns = 0;
+static uint64_t g_uartFreeAt = 0;   // Virtual time the Tx FIFO will be empty
+static uint64_t g_filledEnd = 0;    // Virtual time the newest sample of the last block filled was taken
+static uint64_t g_blockEnd = 0;     // Same for the last block filtered
+static uint32_t g_blocks = 0;       // Blocks the altitude task has filtered
+static uint32_t g_usedBlocks = 0;   // Blocks the controller has set the PWM from
+static uint32_t g_lastUsedBlock = 0;
+static uint64_t g_latencyMin = UINT64_MAX;  // Ticks from the newest sample to the PWM
+static uint64_t g_latencyMax = 0;
+static uint64_t g_latencySum = 0;
+
+
+//*****************************************************************************
+// Synthetic tasks. Each costs a fixed number of microseconds of virtual time.
+//*****************************************************************************
+static void spend(uint32_t us)
+{
+    advanceVirtualTime(US_TO_TICKS(us));
+}
+
+
+//*****************************************************************************
+// The ADC interrupt, once the uDMA has filled a block. The newest sample in
+// it was taken when the interrupt was due, which may be a little before it
+// is entered. It only re-arms the uDMA and posts the block.
+//*****************************************************************************
+static void adcBlockInterrupt(void)
+{
+    spend(ADC_INT_COST_US);
+    g_filledEnd += ADC_BLOCK_TICKS;
+    postEvent(EVENT_ADC_BLOCK);
+}
+
+
+static void filterAltitude(void)
+{
+    spend(ADC_BLOCK_COST_US);
+    g_blockEnd = g_filledEnd;
+    g_blocks++;
+}
+
+
+static void runController(void)
+{
+    spend(CONTROL_COST_US);
+
+    // The PWM is now set from the last whole block, so its samples are as
+    // old as the time since the newest was taken, up to a block more
+    if (g_blocks > 0) {
+        uint64_t latency = getCurTime() - g_blockEnd;
+        g_latencyMin = (latency < g_latencyMin) ? latency : g_latencyMin;
+        g_latencyMax = (latency > g_latencyMax) ? latency : g_latencyMax;
+        g_latencySum += latency;
+        if (g_blocks != g_lastUsedBlock) {
+            g_lastUsedBlock = g_blocks;
+            g_usedBlocks++;
+        }
+    }
+
+    // Now and then a button edge, posted as the interrupt would
+    g_controlRuns++;
+    if (g_controlRuns % BUTTON_EVENT_PERIOD == 0) {
+        postEvent(EVENT_BUTTON_EDGE);
+    }
+}
+
+
+static void checkControls(void)
+{
+    spend(CONTROLS_COST_US);
+}
+
+
+static void refreshDisplay(void)
+{
+    static TaskState task;
+    static int line;
+
+    TASK_BEGIN(&task);
+    for (line = 0; line < 4; line++) {
+        spend(DISPLAY_LINE_COST_US);
+        if (line < 3) {
+            TASK_YIELD(&task);
+        }
+    }
+    TASK_END(&task);
+}
+
+
+//*****************************************************************************
+// Returns the characters that will fit in the modelled Tx FIFO right now.
+//*****************************************************************************
+static uint32_t uartRoom(void)
+{
+    uint64_t now = getCurTime();
+    if (g_uartFreeAt <= now) {
+        g_uartFreeAt = now;
+        return UART_FIFO_CHARS;
+    }
+    uint64_t waiting = (g_uartFreeAt - now + UART_CHAR_TICKS - 1) / UART_CHAR_TICKS;
+    return (waiting >= UART_FIFO_CHARS) ? 0 : (UART_FIFO_CHARS - waiting);
+}
+
+
+static void sendSerialData(void)
+{
+    static TaskState task;
+    static int line;
+    static uint32_t left;
+
+    TASK_BEGIN(&task);
+    for (line = 0; line < 5; line++) {
+        left = SERIAL_LINE_CHARS;
+        while (left > 0) {
+            uint32_t room = uartRoom();
+            if (room == 0) {
+                TASK_YIELD_FOR(&task, UART_CHAR_TICKS * 8);
+                continue;
+            }
+            uint32_t chars = (room < left) ? room : left;
+            spend(chars * SERIAL_CHAR_COST_US);
+            g_uartFreeAt += (uint64_t) chars * UART_CHAR_TICKS;
+            left -= chars;
+        }
+    }
+    TASK_END(&task);
+}
+
+
+//*****************************************************************************
+// Task table, as in main.c
+//*****************************************************************************
+static Process tasks[] = {
+    KERNEL_EVENT_TASK(filterAltitude, EVENT_BIT(EVENT_ADC_BLOCK), "altitude", KERNEL_PRIORITY_HIGH),
+#if CONTROL_FOREGROUND
+    KERNEL_FOREGROUND_TASK(runController, CONTROL_RATE_HZ, "control"),
+#else
+    KERNEL_EVENT_TASK(runController, EVENT_BIT(EVENT_ADC_BLOCK), "control", KERNEL_PRIORITY_HIGH),
+#endif
+    KERNEL_TASK(refreshDisplay, DISPLAY_RATE_HZ, "display", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_LOW),
+    KERNEL_TASK(checkControls, CONTROLS_RATE_HZ, "controls", KERNEL_SKIP_MISSED, KERNEL_PRIORITY_HIGH),
+    KERNEL_EVENT_TASK(checkControls, EVENT_BIT(EVENT_BUTTON_EDGE), "inputs", KERNEL_PRIORITY_HIGH),
+    KERNEL_TASK(sendSerialData, SERIAL_RATE_HZ, "serial", KERNEL_CATCH_UP, KERNEL_PRIORITY_NORMAL),
+};
+
+
+//*****************************************************************************
+// Prints the statistics of every task and the kernel. Returns false if any
+// periodic task missed a period or took longer than its period to respond.
+//*****************************************************************************
+static bool report(uint64_t ticks, uint64_t passes, double hostSeconds)
+{
+    bool ok = true;
+    uint64_t busy = 0;
+    int i = 0;
+
+    printf("%-9s %6s %10s %9s %19s %11s %10s %6s\n", "name", "rate", "runs", "exec(us)",
+           "late(us min/max)", "jitter(us)", "resp(us)", "miss");
+    for (i = 0; i < getNumProcesses(); i++) {
+        ProcessStats stats = getProcessStats(i);
+        uint32_t period = tasks[i].period;
+        uint32_t minLate = (stats.minStartLatency > stats.maxStartLatency) ? 0 : stats.minStartLatency;
+        bool late = (stats.missedPeriods > 0) || (period != 0 && stats.maxResponseTime > period);
+
+        busy += stats.totalExecTime;
+        printf("%-9s %6u %10u %9u %9u/%-9u %11u %10u %6u%s\n", getProcessName(i), tasks[i].rate,
+               stats.runCount, (unsigned) TICKS_TO_US(getProcessMeanExecTime(i)),
+               (unsigned) TICKS_TO_US(minLate), (unsigned) TICKS_TO_US(stats.maxStartLatency),
+               (unsigned) TICKS_TO_US(stats.maxStartLatency - minLate),
+               (unsigned) TICKS_TO_US(stats.maxResponseTime), stats.missedPeriods, late ? "  LATE" : "");
+        if (late) {
+            ok = false;
+        }
+    }
+
+    printf("simulated %.0f s in %.2f s, %llu passes, %.0f ns per pass on this host\n",
+           (double) ticks / SYSTEM_CLOCK_HZ, hostSeconds, (unsigned long long) passes,
+           passes == 0 ? 0.0 : hostSeconds * 1e9 / passes);
+    printf("cpu %.2f%%, asleep %u.%u%%%s\n", 100.0 * busy / ticks,
+           getIdlePermille(0) / 10, getIdlePermille(0) % 10, isShedding() ? ", shedding" : "");
+
+    // The oldest sample in a block was taken a block before the newest
+    uint32_t controlRuns = getProcessStats(findProcess(runController) - tasks).runCount;
+    if (controlRuns > 0 && g_usedBlocks > 0) {
+        printf("sample to PWM (us): newest min/mean/max %u/%u/%u, oldest max %u; "
+               "%.1f new inputs/s from %u us blocks\n",
+               (unsigned) TICKS_TO_US(g_latencyMin), (unsigned) TICKS_TO_US(g_latencySum / controlRuns),
+               (unsigned) TICKS_TO_US(g_latencyMax), (unsigned) TICKS_TO_US(g_latencyMax + ADC_BLOCK_TICKS),
+               (double) g_usedBlocks * SYSTEM_CLOCK_HZ / ticks, (unsigned) TICKS_TO_US(ADC_BLOCK_TICKS));
+    }
+    return ok;
+}
+
+
+//*****************************************************************************
+// Runs the task mix for the given simulated time.
+//*****************************************************************************
+int main(int argc, char* argv[])
+{
+    uint64_t seconds = SIM_SECONDS;
+    uint32_t serialRate = SERIAL_RATE_HZ;
+    uint32_t jitter = SIM_ISR_JITTER_US;
+    bool quiet = false;
+    int option;
+
+    while ((option = getopt(argc, argv, "t:s:j:q")) != -1) {
+        switch (option)
+        {
+            case 't': seconds = strtoull(optarg, 0, 10); break;
+            case 's': serialRate = strtoul(optarg, 0, 10); break;
+            case 'j': jitter = strtoul(optarg, 0, 10); break;
+            case 'q': quiet = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-t seconds] [-s serialHz] [-j jitterUs] [-q]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    initTimer();
+    setVirtualInterruptJitter(US_TO_TICKS(jitter));
+    setVirtualInterrupt(ADC_BLOCK_TICKS, adcBlockInterrupt);
+    initKernel(tasks, KERNEL_TABLE_SIZE(tasks));
+    setProcessRate(findProcess(sendSerialData), serialRate);
+
+    uint64_t end = seconds * SYSTEM_CLOCK_HZ;
+    uint64_t passes = 0;
+    struct timespec hostStart, hostEnd;
+    clock_gettime(CLOCK_MONOTONIC, &hostStart);
+    while (getCurTime() < end) {
+        runKernelPass();
+        advanceVirtualTime(SIM_PASS_TICKS);
+        passes++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &hostEnd);
+    double hostSeconds = (hostEnd.tv_sec - hostStart.tv_sec) + (hostEnd.tv_nsec - hostStart.tv_nsec) / 1e9;
+
+    printf("kernelSim: %s pass, controller %s, serial %u Hz, interrupts up to %u us late\n",
+           KERNEL_IDLE_SLEEP ? "deadline" : "polling", CONTROL_FOREGROUND ? "in foreground" : "on ADC blocks",
+           serialRate, jitter);
+    bool ok = report(getCurTime(), passes, hostSeconds);
+    if (!quiet || !ok) {
+        printf("%s\n", ok ? "ok" : "FAILED: a task missed its deadline");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,315 @@
+// *******************************************************
+//
+// driverlib.c
+//
+// Host stand-ins for the TivaWare functions the firmware
+// uses, so it can be built and tested on Linux. Functions
+// that read or load a timer use the host registers in
+// tivaware.h, so a test can set what they see. The ADC and
+// uDMA are modelled well enough to run the altitude
+// module's interrupt handlers on the samples a test gives.
+// Functions that only set up a peripheral do nothing.
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include "tivaware.h"
+
+
+//*****************************************************************************
+// Globals
+//*****************************************************************************
+volatile uint32_t g_hostRegisters[HOST_REGISTER_WORDS];
+static bool g_masked = false;       // Set while interrupts would be masked
+static uint32_t g_adcTimerBase = 0; // Timer set to trigger the ADC
+static uint32_t (*g_adcInput)(void);    // Gives each conversion
+static uint32_t g_adcOversample = 1;
+static uint32_t g_adcSteps = 0;     // Steps up to and including the one marked ADC_CTL_END
+static bool g_adcInterruptOnEnd = false;
+static bool g_adcInterruptEnabled = false;
+static bool g_adcDma = false;       // Set once the sequence hands its samples to the uDMA
+static void (*g_adcHandler)(void);
+static uint32_t g_adcFifo[HOST_ADC_STEPS];
+static uint32_t g_adcFifoCount = 0;
+static HostAdcStats g_adcStats;
+
+// The primary and alternate control structures of the ADC's uDMA channel
+typedef struct {
+    uint32_t mode;
+    uint16_t* next;         // Where the next sample goes
+    uint32_t left;          // Samples left before this half is done
+} HostDmaHalf;
+static HostDmaHalf g_dmaHalves[2];
+static uint8_t g_dmaActive = 0;     // Half being filled, 0 primary and 1 alternate
+
+
+//*****************************************************************************
+// System control
+//*****************************************************************************
+void SysCtlPeripheralEnable(uint32_t peripheral) { (void) peripheral; }
+void SysCtlPeripheralReset(uint32_t peripheral) { (void) peripheral; }
+void SysCtlSleep(void) {}
+
+
+//*****************************************************************************
+// Timers. Timer A's value and load are in the TAV and TAILR registers, and
+// timer B's in TBV and TBILR, which hold the top half of a 64-bit timer.
+//*****************************************************************************
+void TimerEnable(uint32_t base, uint32_t timer) { (void) base; (void) timer; }
+void TimerDisable(uint32_t base, uint32_t timer) { (void) base; (void) timer; }
+void TimerConfigure(uint32_t base, uint32_t config) { (void) base; (void) config; }
+
+void TimerControlTrigger(uint32_t base, uint32_t timer, bool enable)
+{
+    (void) timer;
+    g_adcTimerBase = enable ? base : 0;
+}
+
+void TimerIntRegister(uint32_t base, uint32_t timer, void (*handler)(void)) { (void) base; (void) timer; (void) handler; }
+void TimerIntEnable(uint32_t base, uint32_t flags) { (void) base; (void) flags; }
+void TimerIntClear(uint32_t base, uint32_t flags) { (void) base; (void) flags; }
+
+void TimerLoadSet(uint32_t base, uint32_t timer, uint32_t value)
+{
+    if (timer & TIMER_A) {
+        HWREG(base + TIMER_O_TAILR) = value;
+    }
+    if (timer & TIMER_B) {
+        HWREG(base + TIMER_O_TBILR) = value;
+    }
+}
+
+void TimerLoadSet64(uint32_t base, uint64_t value)
+{
+    HWREG(base + TIMER_O_TBILR) = (uint32_t) (value >> 32);
+    HWREG(base + TIMER_O_TAILR) = (uint32_t) value;
+}
+
+uint32_t TimerLoadGet(uint32_t base, uint32_t timer)
+{
+    return HWREG(base + ((timer == TIMER_B) ? TIMER_O_TBILR : TIMER_O_TAILR));
+}
+
+uint32_t TimerValueGet(uint32_t base, uint32_t timer)
+{
+    return HWREG(base + ((timer == TIMER_B) ? TIMER_O_TBV : TIMER_O_TAV));
+}
+
+// As TivaWare reads it: the top half again until it has not changed, in
+// case the bottom half wrapped between the two reads
+uint64_t TimerValueGet64(uint32_t base)
+{
+    uint32_t high1, high2, low;
+
+    high2 = HWREG(base + TIMER_O_TBV);
+    do {
+        high1 = high2;
+        low = HWREG(base + TIMER_O_TAV);
+        high2 = HWREG(base + TIMER_O_TBV);
+    } while (high1 != high2);
+    return ((uint64_t) high1 << 32) | low;
+}
+
+
+//*****************************************************************************
+// ADC sequence 0
+//*****************************************************************************
+void ADCSequenceConfigure(uint32_t base, uint32_t sequence, uint32_t trigger, uint32_t priority)
+{
+    (void) base; (void) sequence; (void) trigger; (void) priority;
+}
+void ADCSequenceEnable(uint32_t base, uint32_t sequence) { (void) base; (void) sequence; }
+void ADCIntClear(uint32_t base, uint32_t sequence) { (void) base; (void) sequence; }
+
+void ADCHardwareOversampleConfigure(uint32_t base, uint32_t factor)
+{
+    (void) base;
+    g_adcOversample = factor;
+}
+
+void ADCSequenceStepConfigure(uint32_t base, uint32_t sequence, uint32_t step, uint32_t config)
+{
+    (void) base; (void) sequence;
+    if (config & ADC_CTL_END) {
+        g_adcSteps = step + 1;
+        g_adcInterruptOnEnd = (config & ADC_CTL_IE) != 0;
+    }
+}
+
+void ADCSequenceDMAEnable(uint32_t base, uint32_t sequence)
+{
+    (void) base; (void) sequence;
+    g_adcDma = true;
+}
+
+int32_t ADCSequenceDataGet(uint32_t base, uint32_t sequence, uint32_t* buffer)
+{
+    uint32_t i;
+    (void) base; (void) sequence;
+    for (i = 0; i < g_adcFifoCount; i++) {
+        buffer[i] = g_adcFifo[i];
+    }
+    g_adcStats.cpuSamples += g_adcFifoCount;
+    g_adcFifoCount = 0;
+    return i;
+}
+
+void ADCIntRegister(uint32_t base, uint32_t sequence, void (*handler)(void))
+{
+    (void) base; (void) sequence;
+    g_adcHandler = handler;
+}
+
+void ADCIntEnable(uint32_t base, uint32_t sequence)
+{
+    (void) base; (void) sequence;
+    g_adcInterruptEnabled = true;
+}
+
+
+//*****************************************************************************
+// uDMA
+//*****************************************************************************
+void uDMAEnable(void) {}
+void uDMAControlBaseSet(void* table) { (void) table; }
+void uDMAChannelAttributeDisable(uint32_t channel, uint32_t attributes) { (void) channel; (void) attributes; }
+void uDMAChannelControlSet(uint32_t channel, uint32_t control) { (void) channel; (void) control; }
+void uDMAChannelEnable(uint32_t channel) { (void) channel; }
+
+void uDMAChannelTransferSet(uint32_t channel, uint32_t mode, void* source, void* destination, uint32_t count)
+{
+    HostDmaHalf* half = &g_dmaHalves[(channel & UDMA_ALT_SELECT) ? 1 : 0];
+    (void) source;
+    half->mode = mode;
+    half->next = destination;
+    half->left = count;
+}
+
+uint32_t uDMAChannelModeGet(uint32_t channel)
+{
+    return g_dmaHalves[(channel & UDMA_ALT_SELECT) ? 1 : 0].mode;
+}
+
+
+//*****************************************************************************
+// Moves one sample into the active uDMA half. Returns true if that finished
+// the half, which raises the ADC interrupt.
+//*****************************************************************************
+static bool dmaSample(uint32_t sample)
+{
+    HostDmaHalf* half = &g_dmaHalves[g_dmaActive];
+    if (half->mode == UDMA_MODE_STOP) {
+        g_adcStats.lost++;
+        return false;
+    }
+    *half->next++ = (uint16_t) sample;
+    half->left--;
+    if (half->left > 0) {
+        return false;
+    }
+    half->mode = UDMA_MODE_STOP;
+    g_dmaActive ^= 1;
+    return true;
+}
+
+
+//*****************************************************************************
+// Sets the function that gives each conversion the ADC makes.
+//*****************************************************************************
+void setHostAdcInput(uint32_t (*conversion)(void))
+{
+    g_adcInput = conversion;
+}
+
+
+//*****************************************************************************
+// Returns the ticks between triggers of the ADC sequence, from the load of
+// the timer set to trigger it, or 0 if there is none.
+//*****************************************************************************
+uint32_t getHostAdcTriggerPeriod(void)
+{
+    return (g_adcTimerBase == 0) ? 0 : TimerLoadGet(g_adcTimerBase, TIMER_A) + 1;
+}
+
+
+//*****************************************************************************
+// Runs the sequence once, as the timer would trigger it, and then the
+// interrupt handler if the sequence or the uDMA raised the interrupt.
+//*****************************************************************************
+void triggerHostAdc(void)
+{
+    bool interrupt = false;
+    uint32_t step, i;
+
+    g_adcStats.triggers++;
+    for (step = 0; step < g_adcSteps; step++) {
+        uint32_t sum = 0;
+        for (i = 0; i < g_adcOversample; i++) {
+            sum += g_adcInput();
+        }
+        g_adcStats.conversions += g_adcOversample;
+        g_adcStats.samples++;
+
+        uint32_t sample = sum / g_adcOversample;
+        if (g_adcDma) {
+            interrupt |= dmaSample(sample);
+        } else if (g_adcFifoCount < HOST_ADC_STEPS) {
+            g_adcFifo[g_adcFifoCount++] = sample;
+        } else {
+            g_adcStats.lost++;
+        }
+    }
+    if (!g_adcDma && g_adcInterruptOnEnd) {
+        interrupt = true;
+    }
+
+    if (interrupt && g_adcInterruptEnabled && !g_masked && g_adcHandler != 0) {
+        g_adcStats.interrupts++;
+        g_adcHandler();
+    }
+}
+
+
+//*****************************************************************************
+// Returns the counts kept by the ADC stand-in.
+//*****************************************************************************
+HostAdcStats getHostAdcStats(void)
+{
+    return g_adcStats;
+}
+
+
+//*****************************************************************************
+// Interrupt controller
+//*****************************************************************************
+bool IntMasterDisable(void)
+{
+    bool wasMasked = g_masked;
+    g_masked = true;
+    return wasMasked;
+}
+
+bool IntMasterEnable(void)
+{
+    bool wasMasked = g_masked;
+    g_masked = false;
+    return wasMasked;
+}
+
+void IntPrioritySet(uint32_t interrupt, uint8_t priority) { (void) interrupt; (void) priority; }
+
+
+//*****************************************************************************
+// Returns true while interrupts are masked, so a test can check they are
+// always unmasked again.
+//*****************************************************************************
+bool isHostMasked(void)
+{
+    return g_masked;
+}
@@ -0,0 +1,7 @@
+#ifndef STUBS_ADC_H_
+#define STUBS_ADC_H_
+
+// Host stand-in for the TivaWare header, for the host tests only.
+#include "tivaware.h"
+
+#endif /* STUBS_ADC_H_ */
@@ -0,0 +1,7 @@
+#ifndef STUBS_PIN_MAP_H_
+#define STUBS_PIN_MAP_H_
+
+// Host stand-in for the TivaWare header, for the host tests only.
+#include "tivaware.h"
+
+#endif /* STUBS_PIN_MAP_H_ */
@@ -0,0 +1,7 @@
+#ifndef STUBS_UDMA_H_
+#define STUBS_UDMA_H_
+
+// Host stand-in for the TivaWare header, for the host tests only.
+#include "tivaware.h"
+
+#endif /* STUBS_UDMA_H_ */
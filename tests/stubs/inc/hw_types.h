@@ -0,0 +1,7 @@
+#ifndef STUBS_HW_TYPES_H_
+#define STUBS_HW_TYPES_H_
+
+// Host stand-in for the TivaWare header, for the host tests only.
+#include "tivaware.h"
+
+#endif /* STUBS_HW_TYPES_H_ */
@@ -0,0 +1,7 @@
+#ifndef STUBS_TM4C123GH6PM_H_
+#define STUBS_TM4C123GH6PM_H_
+
+// Host stand-in for the TivaWare header, for the host tests only.
+#include "tivaware.h"
+
+#endif /* STUBS_TM4C123GH6PM_H_ */
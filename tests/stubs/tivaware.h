@@ -0,0 +1,158 @@
+#ifndef STUBS_TIVAWARE_H_
+#define STUBS_TIVAWARE_H_
+
+// *******************************************************
+//
+// tivaware.h
+//
+// Host stand-ins for the parts of TivaWare the firmware
+// uses, for the host tests only. The driverlib and inc
+// headers in this directory all include this one. The
+// functions are in driverlib.c.
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//*****************************************************************************
+// Registers. Each is a word of host memory, found by the low 20 bits of its
+// address, which tells apart every register the firmware uses. A test can
+// set a register, such as the cycle counter, to stand in for the hardware.
+//*****************************************************************************
+#define HOST_REGISTER_WORDS (1u << 18)
+extern volatile uint32_t g_hostRegisters[HOST_REGISTER_WORDS];
+#define HWREG(x) (g_hostRegisters[((uint32_t) (x) & 0xFFFFF) >> 2])
+
+//*****************************************************************************
+// Memory map and interrupt numbers
+//*****************************************************************************
+#define ADC0_BASE 0x40038000
+#define TIMER1_BASE 0x40031000
+#define TIMER2_BASE 0x40032000
+#define WTIMER4_BASE 0x4004E000
+#define WTIMER5_BASE 0x4004F000
+#define INT_TIMER1A 37
+
+//*****************************************************************************
+// System control
+//*****************************************************************************
+#define SYSCTL_PERIPH_ADC0 0xf0003800
+#define SYSCTL_PERIPH_TIMER1 0xf0000401
+#define SYSCTL_PERIPH_TIMER2 0xf0000402
+#define SYSCTL_PERIPH_WTIMER4 0xf0005c04
+#define SYSCTL_PERIPH_WTIMER5 0xf0005c05
+#define SYSCTL_PERIPH_UDMA 0xf0000c00
+
+void SysCtlPeripheralEnable(uint32_t peripheral);
+void SysCtlPeripheralReset(uint32_t peripheral);
+void SysCtlSleep(void);
+
+//*****************************************************************************
+// Timers
+//*****************************************************************************
+#define TIMER_O_TAILR 0x028
+#define TIMER_O_TBILR 0x02C
+#define TIMER_O_TAV 0x050
+#define TIMER_O_TBV 0x054
+#define TIMER_A 0x000000ff
+#define TIMER_B 0x0000ff00
+#define TIMER_BOTH 0x0000ffff
+#define TIMER_CFG_PERIODIC 0x00000022
+#define TIMER_CFG_SPLIT_PAIR 0x04000000
+#define TIMER_CFG_A_ONE_SHOT 0x00000021
+#define TIMER_TIMA_TIMEOUT 0x00000001
+
+void TimerEnable(uint32_t base, uint32_t timer);
+void TimerDisable(uint32_t base, uint32_t timer);
+void TimerConfigure(uint32_t base, uint32_t config);
+void TimerControlTrigger(uint32_t base, uint32_t timer, bool enable);
+void TimerLoadSet(uint32_t base, uint32_t timer, uint32_t value);
+void TimerLoadSet64(uint32_t base, uint64_t value);
+uint32_t TimerLoadGet(uint32_t base, uint32_t timer);
+uint32_t TimerValueGet(uint32_t base, uint32_t timer);
+uint64_t TimerValueGet64(uint32_t base);
+void TimerIntRegister(uint32_t base, uint32_t timer, void (*handler)(void));
+void TimerIntEnable(uint32_t base, uint32_t flags);
+void TimerIntClear(uint32_t base, uint32_t flags);
+
+//*****************************************************************************
+// ADC. The stand-in converts whatever the test's input function returns,
+// averaging ADC_OVERSAMPLE conversions into each sample as the hardware
+// does. Each time the test calls triggerHostAdc the sequence takes a sample
+// for each step. Without the uDMA they wait in the sequence FIFO for the
+// interrupt handler; with it they are moved into the uDMA buffers.
+//*****************************************************************************
+#define ADC_O_SSFIFO0 0x048
+#define ADC_TRIGGER_TIMER 0x00000005
+#define ADC_CTL_CH9 0x00000009
+#define ADC_CTL_END 0x00000020
+#define ADC_CTL_IE 0x00000040
+#define HOST_ADC_STEPS 8            // Steps in sequence 0, and the depth of its FIFO
+
+void ADCHardwareOversampleConfigure(uint32_t base, uint32_t factor);
+void ADCSequenceConfigure(uint32_t base, uint32_t sequence, uint32_t trigger, uint32_t priority);
+void ADCSequenceStepConfigure(uint32_t base, uint32_t sequence, uint32_t step, uint32_t config);
+void ADCSequenceEnable(uint32_t base, uint32_t sequence);
+void ADCSequenceDMAEnable(uint32_t base, uint32_t sequence);
+int32_t ADCSequenceDataGet(uint32_t base, uint32_t sequence, uint32_t* buffer);
+void ADCIntRegister(uint32_t base, uint32_t sequence, void (*handler)(void));
+void ADCIntEnable(uint32_t base, uint32_t sequence);
+void ADCIntClear(uint32_t base, uint32_t sequence);
+
+//*****************************************************************************
+// uDMA. Only the ping-pong mode the ADC uses is modelled. A half finishes
+// when its count runs out, and the uDMA then carries on into the other.
+//*****************************************************************************
+#define UDMA_CHANNEL_ADC0 14
+#define UDMA_PRI_SELECT 0x00000000
+#define UDMA_ALT_SELECT 0x00000020
+#define UDMA_ATTR_USEBURST 0x00000001
+#define UDMA_ATTR_ALTSELECT 0x00000002
+#define UDMA_ATTR_HIGH_PRIORITY 0x00000004
+#define UDMA_ATTR_REQMASK 0x00000008
+#define UDMA_MODE_STOP 0x00000000
+#define UDMA_MODE_PINGPONG 0x00000003
+#define UDMA_SIZE_16 0x55000000
+#define UDMA_SRC_INC_NONE 0x0c000000
+#define UDMA_DST_INC_16 0x40000000
+#define UDMA_ARB_8 0x0000c000
+
+void uDMAEnable(void);
+void uDMAControlBaseSet(void* table);
+void uDMAChannelAttributeDisable(uint32_t channel, uint32_t attributes);
+void uDMAChannelControlSet(uint32_t channel, uint32_t control);
+void uDMAChannelTransferSet(uint32_t channel, uint32_t mode, void* source, void* destination, uint32_t count);
+void uDMAChannelEnable(uint32_t channel);
+uint32_t uDMAChannelModeGet(uint32_t channel);
+
+//*****************************************************************************
+// Driving and watching the ADC stand-in
+//*****************************************************************************
+typedef struct {
+    uint32_t triggers;      // Times the sequence was triggered
+    uint32_t conversions;   // Conversions made, before averaging
+    uint32_t samples;       // Averaged samples made
+    uint32_t cpuSamples;    // Samples read by the CPU from the FIFO
+    uint32_t interrupts;    // Times the ADC interrupt handler was run
+    uint32_t lost;          // Samples lost to a full FIFO or a stalled uDMA
+} HostAdcStats;
+
+void setHostAdcInput(uint32_t (*conversion)(void));
+uint32_t getHostAdcTriggerPeriod(void);
+void triggerHostAdc(void);
+HostAdcStats getHostAdcStats(void);
+
+//*****************************************************************************
+// Interrupt controller. There are no interrupts on the host, so masking them
+// only records that they are masked.
+//*****************************************************************************
+bool IntMasterDisable(void);
+bool IntMasterEnable(void);
+void IntPrioritySet(uint32_t interrupt, uint8_t priority);
+bool isHostMasked(void);
+
+#endif /* STUBS_TIVAWARE_H_ */
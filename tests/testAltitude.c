@@ -0,0 +1,262 @@
+// *******************************************************
+//
+// testAltitude.c
+//
+// Host test of altitude.c, run on the ADC and uDMA
+// stand-ins in stubs/driverlib.c against the virtual
+// timings. The stand-in ADC is triggered at the period the
+// altitude module sets its timer to, and runs the module's
+// own interrupt handler whenever the hardware would. Checks
+// the interrupt load and samples read by the CPU against
+// the SysTick-triggered design it replaced, the events
+// posted, the altitude and climb rate on steady and ramped
+// inputs, and the raw sample recording. Built once with
+// the uDMA and once without, and so without the decimator
+// (see the Makefile). Exits with 1 if any check fails.
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include "altitude.h"
+#include "events.h"
+#include "timings.h"
+#include "driverlib/adc.h"
+
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#define OLD_INTERRUPT_RATE (2 * SAMPLE_RATE_HZ)    // SysTick trigger plus ADC interrupt per sample
+#define MIN_INTERRUPT_REDUCTION 10  // Times fewer interrupts than OLD_INTERRUPT_RATE needed either way
+#define STEADY_LEVEL 2000           // ADC value of the steady input
+#define RAMP_RATE 240               // ADC steps per second the ramp falls by, as when climbing
+#define RAMP_RATE_TOLERANCE 5       // Percent the mean fitted climb rate may be out by
+
+#if ALTITUDE_DMA
+#define EXPECTED_INTERRUPTS ((SAMPLE_RATE_HZ * CIC_DECIMATION) / ADC_DMA_BLOCK_SIZE)
+#define EXPECTED_CPU_SAMPLES 0
+#define EXPECTED_EVENTS EXPECTED_INTERRUPTS
+#else
+#define EXPECTED_INTERRUPTS ((SAMPLE_RATE_HZ * CIC_DECIMATION) / ADC_BLOCK_STEPS)
+#define EXPECTED_CPU_SAMPLES (SAMPLE_RATE_HZ * CIC_DECIMATION)
+#define EXPECTED_EVENTS (SAMPLE_RATE_HZ / BUF_SIZE)
+#endif
+
+
+//*****************************************************************************
+// Globals to module
+//*****************************************************************************
+static int g_failures = 0;
+static double g_level = STEADY_LEVEL;   // Input now, in ADC steps
+static double g_slope = 0;              // ADC steps per tick the input changes by
+static uint32_t g_counting = 0;         // Next value of the counting input
+static uint32_t g_conversions = 0;      // Conversions made for the current sample
+
+
+//*****************************************************************************
+// Counts and reports a failed check.
+//*****************************************************************************
+#define CHECK(condition) \
+    do { if (!(condition)) { printf("FAILED line %d: %s\n", __LINE__, #condition); g_failures++; } } while (0)
+
+
+//*****************************************************************************
+// Inputs for the stand-in ADC. The level one follows g_level, and the
+// counting one gives each averaged sample the next number up.
+//*****************************************************************************
+static uint32_t levelInput(void)
+{
+    return (uint32_t) (g_level + 0.5);
+}
+
+static uint32_t countingInput(void)
+{
+    uint32_t value = g_counting & 0xFFF;
+    if (++g_conversions == ADC_OVERSAMPLE) {
+        g_conversions = 0;
+        g_counting++;
+    }
+    return value;
+}
+
+
+//*****************************************************************************
+// Runs the ADC for the given number of timer triggers, moving virtual time
+// on and the level input along its slope between them, and filtering any
+// finished blocks as the EVENT_ADC_BLOCK task would. Returns the number of
+// times EVENT_ADC_BLOCK was posted.
+//*****************************************************************************
+static uint32_t runTriggers(uint32_t triggers)
+{
+    uint32_t events = 0;
+    uint32_t i;
+
+    for (i = 0; i < triggers; i++) {
+        uint32_t period = getHostAdcTriggerPeriod();
+        advanceVirtualTime(period);
+        g_level += g_slope * period;
+        triggerHostAdc();
+        if (takeEvents() & EVENT_BIT(EVENT_ADC_BLOCK)) {
+            events++;
+            processAltitudeBlocks();
+        }
+    }
+    return events;
+}
+
+
+//*****************************************************************************
+// Returns the timer triggers in one second at the current sample rate.
+//*****************************************************************************
+static uint32_t triggersPerSecond(void)
+{
+    return SYSTEM_CLOCK_HZ / getHostAdcTriggerPeriod();
+}
+
+
+//*****************************************************************************
+// One second of a steady input: the interrupt load, the samples the CPU has
+// to move, the events posted, and the altitude.
+//*****************************************************************************
+static void testSteady(void)
+{
+    HostAdcStats before = getHostAdcStats();
+    uint32_t events = runTriggers(triggersPerSecond());
+    HostAdcStats after = getHostAdcStats();
+    uint32_t interrupts = after.interrupts - before.interrupts;
+    uint32_t cpuSamples = after.cpuSamples - before.cpuSamples;
+
+    printf("%s: %u samples/s from %u conversions/s; %u interrupts/s (%.0fx fewer than %u), "
+           "CPU reads %u samples/s, %u events/s\n",
+           ALTITUDE_DMA ? "uDMA" : "no uDMA", after.samples - before.samples,
+           after.conversions - before.conversions, interrupts,
+           (double) OLD_INTERRUPT_RATE / interrupts, OLD_INTERRUPT_RATE, cpuSamples, events);
+
+    CHECK(after.samples - before.samples == SAMPLE_RATE_HZ * CIC_DECIMATION);
+    CHECK(interrupts >= EXPECTED_INTERRUPTS && interrupts <= EXPECTED_INTERRUPTS + 1);
+    CHECK(interrupts * MIN_INTERRUPT_REDUCTION <= OLD_INTERRUPT_RATE);
+    CHECK(cpuSamples == EXPECTED_CPU_SAMPLES);
+    CHECK(events >= EXPECTED_EVENTS && events <= EXPECTED_EVENTS + 1);
+    CHECK(after.lost == 0);
+    CHECK(getAltitudeBlockOverruns() == 0);
+    CHECK(getAltitudeADC() == STEADY_LEVEL);
+    CHECK(getAltitudeRate() == 0);
+}
+
+
+//*****************************************************************************
+// A steady climb: the ADC value falls at RAMP_RATE steps a second, and the
+// fitted climb rate should match it. Without the uDMA the rate is fitted
+// over under one ADC step of the ramp, so any one fit can be well out; the
+// mean over the last half second is checked instead.
+//*****************************************************************************
+static void testRamp(void)
+{
+    int32_t expected = (RAMP_RATE * 100 * ALTITUDE_FRAC_SCALE) / (ADC_ONE_VOLT * ALTITUDE_VOLTAGE_RANGE);
+    uint32_t triggers = triggersPerSecond();
+    int64_t sum = 0;
+    uint32_t i;
+
+    g_slope = -(double) RAMP_RATE / SYSTEM_CLOCK_HZ;
+    runTriggers(triggers / 2);
+    for (i = 0; i < triggers / 2; i++) {
+        runTriggers(1);
+        sum += getAltitudeRate();
+    }
+    int32_t last = getAltitudeRate();
+    int32_t mean = (int32_t) (sum / (triggers / 2));
+    g_slope = 0;
+
+    printf("climb: mean %d and last %d fitted against %d, in 1/%u %% per second\n",
+           mean, last, expected, ALTITUDE_FRAC_SCALE);
+    CHECK(abs(mean - expected) * 100 <= expected * RAMP_RATE_TOLERANCE);
+}
+
+
+//*****************************************************************************
+// Records the raw samples of the counting input, reading them out while they
+// are still being recorded, and checks none were missed or repeated.
+//*****************************************************************************
+static void testRecording(void)
+{
+    uint32_t read = 0;
+    uint32_t wrong = 0;
+    uint32_t first = 0;
+    uint16_t sample;
+
+    // Let the samples of the level input already taken through first, as
+    // the uDMA only hands them on a block at a time
+    setHostAdcInput(countingInput);
+    runTriggers(triggersPerSecond() / 10);
+    CHECK(startAltitudeRecording());
+    CHECK(!startAltitudeRecording());
+    while (isAltitudeRecording()) {
+        runTriggers(1);
+        while (read < RECORD_SIZE / 2 && readAltitudeRecording(&sample)) {
+            if (read == 0) {
+                first = sample;
+            } else if (sample != ((first + read) & 0xFFF)) {
+                wrong++;
+            }
+            read++;
+        }
+    }
+    while (readAltitudeRecording(&sample)) {
+        if (sample != ((first + read) & 0xFFF)) {
+            wrong++;
+        }
+        read++;
+    }
+    setHostAdcInput(levelInput);
+
+    printf("recording: %u samples at %u Hz, %u out of sequence\n", read, getAltitudeRecordRate(), wrong);
+    CHECK(read >= RECORD_SIZE);
+    CHECK(wrong == 0);
+    CHECK(getAltitudeRecordRate() == SAMPLE_RATE_HZ * CIC_DECIMATION);
+    CHECK(startAltitudeRecording());
+    runTriggers(RECORD_SIZE);
+    CHECK(!isAltitudeRecording());
+    while (readAltitudeRecording(&sample)) {
+    }
+}
+
+
+//*****************************************************************************
+// While landed the timer triggers the ADC less often.
+//*****************************************************************************
+static void testLandedRate(void)
+{
+    uint32_t period = getHostAdcTriggerPeriod();
+    setAltitudeSampleRate(LANDED_SAMPLE_RATE_HZ);
+    CHECK(getHostAdcTriggerPeriod() * LANDED_SAMPLE_RATE_HZ == period * SAMPLE_RATE_HZ);
+    setAltitudeSampleRate(SAMPLE_RATE_HZ);
+    CHECK(getHostAdcTriggerPeriod() == period);
+}
+
+
+int main(void)
+{
+    initTimer();
+    setHostAdcInput(levelInput);
+    initAltitude();
+
+    runTriggers(triggersPerSecond() / 10);
+    testSteady();
+    testRamp();
+    g_level = STEADY_LEVEL;
+    runTriggers(triggersPerSecond() / 10);
+    testRecording();
+    testLandedRate();
+    CHECK(!isHostMasked());
+
+    printf("testAltitude: %s\n", g_failures ? "FAILED" : "ok");
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,257 @@
+// *******************************************************
+//
+// testCic.c
+//
+// Host test of the CIC decimator in cic.c. Checks which
+// orders and ratios initCic accepts, that a steady input
+// comes out unchanged at every order and ratio, even with
+// the registers wrapping, that the fraction bits keep the
+// resolution the averaging makes, and that the gain at a range of
+// frequencies matches |sin(pi f R) / (R sin(pi f))|^N for
+// the order N and ratio R the altitude uses, and for a
+// first order stage. Then times it per input sample at
+// each order. Exits with 1 if any check fails.
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include "cic.h"
+#include "altitude.h"
+
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#define ADC_MAX 4095
+#define SINE_OFFSET 2048            // Middle of the ADC range
+#define SINE_AMPLITUDE 1500.0       // In ADC steps
+#define SINE_OUTPUTS 50000          // Outputs the gain is measured over
+#define GAIN_TOLERANCE 1.0          // Largest error in the output amplitude, in ADC steps
+#define BENCH_SAMPLES 4000000       // Input samples timed at each order
+
+// Frequencies the gain is checked at, as fractions of the input rate. None
+// is a multiple of half the output rate, where it would alias onto DC or the
+// Nyquist frequency.
+static const double g_frequencies[] = {0.002, 0.01, 0.03, 0.06, 0.1, 0.15, 0.2, 0.3, 0.4, 0.48};
+
+
+//*****************************************************************************
+// Globals to module
+//*****************************************************************************
+static int g_failures = 0;
+static volatile uint32_t g_sink;    // Keeps the benchmark results from being optimised out
+
+
+//*****************************************************************************
+// Counts and reports a failed check.
+//*****************************************************************************
+#define CHECK(condition) \
+    do { if (!(condition)) { printf("FAILED line %d: %s\n", __LINE__, #condition); g_failures++; } } while (0)
+
+
+static double hostSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+//*****************************************************************************
+// Only orders from 1 to CIC_MAX_ORDER are taken, only if the gain leaves
+// room for the input in the registers, and only as many fraction bits as
+// the gain has.
+//*****************************************************************************
+static void testInit(void)
+{
+    CicDecimator cic;
+
+    CHECK(!initCic(&cic, 0, 2, 0));
+    CHECK(initCic(&cic, 1, 0, 0));
+    CHECK(initCic(&cic, CIC_MAX_ORDER, 2, 0));
+    CHECK(!initCic(&cic, CIC_MAX_ORDER + 1, 2, 0));
+    CHECK(initCic(&cic, 4, (CIC_REGISTER_BITS - CIC_INPUT_BITS) / 4, 0));
+    CHECK(!initCic(&cic, 4, (CIC_REGISTER_BITS - CIC_INPUT_BITS) / 4 + 1, 0));
+    CHECK(initCic(&cic, 2, 2, 4));
+    CHECK(!initCic(&cic, 2, 2, 5));
+    CHECK(!initCic(&cic, 1, 0, 1));
+    CHECK(initCic(&cic, CIC_ORDER, CIC_RATIO_SHIFT, ALTITUDE_ADC_FRAC_BITS));
+}
+
+
+//*****************************************************************************
+// A steady input, once through the combs, comes out exactly as it went in
+// at every order and ratio that initCic takes.
+//*****************************************************************************
+static void testSteady(void)
+{
+    static const uint32_t levels[] = {0, 1, 1234, ADC_MAX};
+    CicDecimator cic;
+    uint8_t order, shift;
+    uint32_t level, i;
+
+    for (order = 1; order <= CIC_MAX_ORDER; order++) {
+        for (shift = 0; initCic(&cic, order, shift, 0); shift++) {
+            for (level = 0; level < sizeof(levels) / sizeof(levels[0]); level++) {
+                uint32_t outputs = 0;
+                uint32_t wrong = 0;
+                initCic(&cic, order, shift, 0);
+
+                // Long enough for the integrators to wrap at the highest gain
+                for (i = 0; i < (1u << 20); i++) {
+                    uint32_t output;
+                    if (cicSample(&cic, levels[level], &output)) {
+                        outputs++;
+                        if (outputs > order && output != levels[level]) {
+                            wrong++;
+                        }
+                    }
+                }
+                CHECK(outputs == (1u << (20 - shift)));
+                CHECK(wrong == 0);
+            }
+        }
+    }
+}
+
+
+//*****************************************************************************
+// An input between two ADC steps, a quarter of the time on the higher one,
+// comes out a quarter of a step up with the altitude's fraction bits, where
+// without them it would round to the lower step.
+//*****************************************************************************
+static void testFraction(void)
+{
+    static const uint32_t pattern[] = {1001, 1000, 1000, 1000};
+    CicDecimator cic;
+    uint32_t outputs = 0;
+    uint32_t wrong = 0;
+    uint32_t i;
+
+    initCic(&cic, CIC_ORDER, 2, 2);
+    for (i = 0; i < 4096; i++) {
+        uint32_t output;
+        if (cicSample(&cic, pattern[i % 4], &output)) {
+            outputs++;
+            if (outputs > CIC_ORDER && output != 4001) {
+                wrong++;
+            }
+        }
+    }
+    CHECK(wrong == 0);
+
+    outputs = 0;
+    wrong = 0;
+    initCic(&cic, CIC_ORDER, 2, 0);
+    for (i = 0; i < 4096; i++) {
+        uint32_t output;
+        if (cicSample(&cic, pattern[i % 4], &output)) {
+            outputs++;
+            if (outputs > CIC_ORDER && output != 1000) {
+                wrong++;
+            }
+        }
+    }
+    CHECK(wrong == 0);
+}
+
+
+//*****************************************************************************
+// Puts a sine wave in, and returns the amplitude of what comes out at the
+// same (possibly aliased) frequency.
+//*****************************************************************************
+static double measureGain(uint8_t order, uint8_t shift, double frequency)
+{
+    CicDecimator cic;
+    uint32_t ratio = 1u << shift;
+    double sumCos = 0, sumSin = 0;
+    uint32_t outputs = 0;
+    uint64_t n = 0;
+
+    initCic(&cic, order, shift, 0);
+    while (outputs < SINE_OUTPUTS + (uint32_t) order) {
+        uint32_t output;
+        double phase = 2 * M_PI * frequency * n;
+        uint32_t sample = (uint32_t) lround(SINE_OFFSET + SINE_AMPLITUDE * sin(phase));
+        n++;
+        if (cicSample(&cic, sample, &output)) {
+            // Skip the outputs from before the combs had settled
+            outputs++;
+            if (outputs > order) {
+                double outPhase = 2 * M_PI * frequency * ratio * (outputs - order);
+                sumCos += ((double) output - SINE_OFFSET) * cos(outPhase);
+                sumSin += ((double) output - SINE_OFFSET) * sin(outPhase);
+            }
+        }
+    }
+    return 2.0 * sqrt(sumCos * sumCos + sumSin * sumSin) / SINE_OUTPUTS;
+}
+
+
+//*****************************************************************************
+// Checks the gain of the altitude's decimator against the expected response.
+//*****************************************************************************
+static void testResponse(uint8_t order, uint8_t shift)
+{
+    double ratio = 1u << shift;
+    uint32_t i;
+
+    printf("order %u, ratio %u\n%10s %12s %12s %12s\n", order, 1u << shift,
+           "f/fs", "expected(dB)", "measured(dB)", "error(steps)");
+    for (i = 0; i < sizeof(g_frequencies) / sizeof(g_frequencies[0]); i++) {
+        double f = g_frequencies[i];
+        double expected = pow(fabs(sin(M_PI * f * ratio) / (ratio * sin(M_PI * f))), order);
+        double measured = measureGain(order, shift, f) / SINE_AMPLITUDE;
+        double error = fabs(measured - expected) * SINE_AMPLITUDE;
+        printf("%10.3f %12.1f %12.1f %12.2f\n", f, 20 * log10(expected), 20 * log10(fmax(measured, 1e-6)), error);
+        CHECK(error < GAIN_TOLERANCE);
+    }
+}
+
+
+//*****************************************************************************
+// Times the decimator at each order with the altitude's ratio, in ns per
+// input sample, including the comb run on every output.
+//*****************************************************************************
+static void benchmark(void)
+{
+    CicDecimator cic;
+    uint8_t order;
+    uint32_t i;
+
+    printf("%6s %14s\n", "order", "ns per sample");
+    for (order = 1; order <= CIC_MAX_ORDER; order++) {
+        uint32_t output = 0;
+        initCic(&cic, order, CIC_RATIO_SHIFT, 0);
+        double start = hostSeconds();
+        for (i = 0; i < BENCH_SAMPLES; i++) {
+            cicSample(&cic, i & ADC_MAX, &output);
+        }
+        g_sink = output;
+        printf("%6u %14.2f\n", order, (hostSeconds() - start) * 1e9 / BENCH_SAMPLES);
+    }
+}
+
+
+int main(void)
+{
+    testInit();
+    testSteady();
+    testFraction();
+    testResponse(CIC_ORDER, CIC_RATIO_SHIFT);
+    testResponse(1, 3);
+    benchmark();
+
+    printf("testCic: %s\n", g_failures ? "FAILED" : "ok");
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,235 @@
+// *******************************************************
+//
+// testCircBuf.c
+//
+// Host test of the circBufT.h buffers. Writes millions of
+// random samples through a CIRCBUF_SUM buffer and checks
+// the running sum never drifts from the sum of the
+// entries, then times reading the mean from the running
+// sum against summing the window, at several window
+// sizes. Also checks the snapshot spans and copy give the
+// entries oldest first without moving the read index, and
+// times summing the window over the spans against reading
+// it an entry at a time. Exits with 1 if any check fails.
+//
+//     testCircBuf [-n writes]
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include "circBufT.h"
+
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#define DRIFT_WRITES 10000000       // Samples written in the drift check by default
+#define DRIFT_CHECK_EVERY 997       // Writes between comparisons with the entries
+#define ADC_MAX 4095                // Largest 12-bit sample
+#define BENCH_READS 500000          // Means read for each window size
+
+CIRCBUF_SUM_DECLARE(DriftBuf, uint16_t, 20)
+CIRCBUF_SUM_DEFINE(DriftBuf, uint16_t, 20)
+CIRCBUF_SUM_DECLARE(WideBuf, uint32_t, 7)
+CIRCBUF_SUM_DEFINE(WideBuf, uint32_t, 7)
+CIRCBUF_DECLARE(SpanBuf, uint16_t, 5)
+CIRCBUF_DEFINE(SpanBuf, uint16_t, 5)
+
+
+//*****************************************************************************
+// Globals to module
+//*****************************************************************************
+static int g_failures = 0;
+static uint32_t g_driftWrites = DRIFT_WRITES;
+static volatile uint32_t g_sink;    // Keeps the benchmark results from being optimised out
+
+
+//*****************************************************************************
+// Counts and reports a failed check.
+//*****************************************************************************
+#define CHECK(condition) \
+    do { if (!(condition)) { printf("FAILED line %d: %s\n", __LINE__, #condition); g_failures++; } } while (0)
+
+
+static double hostSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+//*****************************************************************************
+// Writes random 12-bit samples, as the ADC would, and checks the running
+// sum against the entries as it goes and at the end.
+//*****************************************************************************
+static void testDrift(void)
+{
+    static DriftBuf_t buffer;
+    uint32_t mismatches = 0;
+    uint32_t i, j;
+
+    initDriftBuf(&buffer);
+    CHECK(getDriftBufSum(&buffer) == 0);
+    for (i = 1; i <= g_driftWrites; i++) {
+        writeDriftBuf(&buffer, rand() % (ADC_MAX + 1));
+        if (i % DRIFT_CHECK_EVERY == 0) {
+            uint32_t sum = 0;
+            for (j = 0; j < 20; j++) {
+                sum += buffer.data[j];
+            }
+            if (sum != getDriftBufSum(&buffer)) {
+                mismatches++;
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(checkDriftBufSum(&buffer));
+
+    // A sum that has been disturbed is found and put right
+    buffer.sum += 3;
+    CHECK(!checkDriftBufSum(&buffer));
+    CHECK(checkDriftBufSum(&buffer));
+    printf("drift: %u writes, %u mismatches\n", g_driftWrites, mismatches);
+}
+
+
+//*****************************************************************************
+// Entries big enough that the sum wraps past 32 bits. It wraps the same way
+// as the sum of the entries, so they still agree.
+//*****************************************************************************
+static void testWrap(void)
+{
+    static WideBuf_t buffer;
+    uint32_t i;
+
+    initWideBuf(&buffer);
+    for (i = 0; i < 100000; i++) {
+        writeWideBuf(&buffer, 0xF0000000u + rand());
+    }
+    CHECK(checkWideBufSum(&buffer));
+}
+
+
+//*****************************************************************************
+// After every number of writes, from none to past a wrap, the spans and the
+// copy hold the last five entries oldest first, and the read index is left
+// where it was.
+//*****************************************************************************
+static void testSpans(void)
+{
+    static SpanBuf_t buffer;
+    uint16_t copied[5];
+    uint16_t i, j;
+
+    initSpanBuf(&buffer);
+    for (i = 0; i < 13; i++) {
+        SpanBufSpan_t span = snapshotSpanBuf(&buffer);
+        copySpanBuf(&buffer, copied);
+        CHECK(span.firstLen + span.secondLen == 5);
+        for (j = 0; j < 5; j++) {
+            uint16_t inSpan = (j < span.firstLen) ? span.first[j] : span.second[j - span.firstLen];
+            uint16_t expected = (i + j >= 5) ? (i + j - 5 + 100) : 0;
+            CHECK(inSpan == expected);
+            CHECK(copied[j] == expected);
+        }
+        CHECK(buffer.rindex == 0);
+        writeSpanBuf(&buffer, 100 + i);
+    }
+}
+
+
+//*****************************************************************************
+// Generates a benchmark for a window of the given size. Each read of the
+// mean follows one write, as when the filter output is worked out for every
+// sample. The old way summed the whole window through the read index, an
+// entry and a call at a time. The spans sum it in place in two loops.
+//*****************************************************************************
+#define BENCH_WINDOW(size) \
+    CIRCBUF_SUM_DECLARE(Bench##size, uint16_t, size) \
+    CIRCBUF_SUM_DEFINE(Bench##size, uint16_t, size) \
+    static void bench##size(void) \
+    { \
+        static Bench##size##_t buffer; \
+        uint32_t i, j; \
+        initBench##size(&buffer); \
+        double start = hostSeconds(); \
+        for (i = 0; i < BENCH_READS; i++) { \
+            writeBench##size(&buffer, i & ADC_MAX); \
+            g_sink = getBench##size##Sum(&buffer) / (size); \
+        } \
+        double running = hostSeconds() - start; \
+        start = hostSeconds(); \
+        for (i = 0; i < BENCH_READS; i++) { \
+            uint32_t sum = 0; \
+            writeBench##size(&buffer, i & ADC_MAX); \
+            for (j = 0; j < (size); j++) { \
+                sum += readBench##size(&buffer); \
+            } \
+            g_sink = sum / (size); \
+        } \
+        double summed = hostSeconds() - start; \
+        start = hostSeconds(); \
+        for (i = 0; i < BENCH_READS; i++) { \
+            uint32_t sum = 0; \
+            writeBench##size(&buffer, i & ADC_MAX); \
+            Bench##size##Span_t span = snapshotBench##size(&buffer); \
+            for (j = 0; j < span.firstLen; j++) { \
+                sum += span.first[j]; \
+            } \
+            for (j = 0; j < span.secondLen; j++) { \
+                sum += span.second[j]; \
+            } \
+            g_sink = sum / (size); \
+        } \
+        double spans = hostSeconds() - start; \
+        printf("%6u %12.2f %12.2f %12.2f\n", (size), running * 1e9 / BENCH_READS, \
+               summed * 1e9 / BENCH_READS, spans * 1e9 / BENCH_READS); \
+    }
+
+BENCH_WINDOW(8)
+BENCH_WINDOW(20)
+BENCH_WINDOW(64)
+BENCH_WINDOW(256)
+BENCH_WINDOW(1024)
+
+
+int main(int argc, char* argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "n:")) != -1) {
+        switch (option)
+        {
+            case 'n': g_driftWrites = strtoul(optarg, 0, 10); break;
+            default:
+                fprintf(stderr, "usage: %s [-n writes]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    srand(361);
+    testDrift();
+    testWrap();
+    testSpans();
+
+    printf("%6s %12s %12s %12s\n", "window", "running(ns)", "summed(ns)", "spans(ns)");
+    bench8();
+    bench20();
+    bench64();
+    bench256();
+    bench1024();
+
+    printf("testCircBuf: %s\n", g_failures ? "FAILED" : "ok");
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+// *******************************************************
+//
+// testMedian.c
+//
+// Host test of the sliding median in filters.c, built
+// once for each window size with -DMEDIAN_SIZE (see the
+// Makefile). Checks every output against sorting a copy
+// of the window, on random samples, on samples with many
+// repeats, and on ramps, then times the median against
+// the boxcar of the same size and against sorting the
+// window afresh for every sample. Exits with 1 if any
+// output differs from the sort.
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "filters.h"
+
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#define TEST_SAMPLES 50000          // Samples checked against the sort for each input
+#define BENCH_SAMPLES 1000000       // Samples timed for each filter
+#define ADC_MAX 4095
+
+enum inputs {
+    INPUT_RANDOM = 0,   // Any 12-bit value
+    INPUT_REPEATS,      // Only a few values, so the window is full of repeats
+    INPUT_RAMP_UP,      // Each new sample is the largest, the most shuffling
+    INPUT_RAMP_DOWN,    // Each new sample is the smallest
+    NUM_INPUTS
+};
+
+
+//*****************************************************************************
+// Globals to module
+//*****************************************************************************
+static uint16_t g_window[MEDIAN_SIZE];     // Reference window, in the order the samples came
+static uint16_t g_input[BENCH_SAMPLES];     // Made before timing, so only the filter is timed
+static volatile uint32_t g_sink;    // Keeps the benchmark results from being optimised out
+
+
+static double hostSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+static int compareSamples(const void* a, const void* b)
+{
+    return *(const uint16_t*) a - *(const uint16_t*) b;
+}
+
+
+//*****************************************************************************
+// Returns the i'th sample of the given input.
+//*****************************************************************************
+static uint16_t makeSample(int input, uint32_t i)
+{
+    switch (input)
+    {
+        case INPUT_RANDOM: return rand() % (ADC_MAX + 1);
+        case INPUT_REPEATS: return 2000 + rand() % 4;
+        case INPUT_RAMP_UP: return i % (ADC_MAX + 1);
+        default: return ADC_MAX - i % (ADC_MAX + 1);
+    }
+}
+
+
+//*****************************************************************************
+// Returns the median of the reference window, by sorting a copy of it.
+//*****************************************************************************
+static uint16_t sortedMedian(void)
+{
+    uint16_t sorted[MEDIAN_SIZE];
+    memcpy(sorted, g_window, sizeof(sorted));
+    qsort(sorted, MEDIAN_SIZE, sizeof(uint16_t), compareSamples);
+    return sorted[MEDIAN_SIZE / 2];
+}
+
+
+//*****************************************************************************
+// Checks the filter against the sort after every sample of an input. The
+// filter starts with a window of zeros, and so does the reference.
+//*****************************************************************************
+static uint32_t checkInput(int input)
+{
+    uint32_t mismatches = 0;
+    uint32_t i;
+
+    setFilter(FILTER_MEDIAN);
+    memset(g_window, 0, sizeof(g_window));
+    for (i = 0; i < TEST_SAMPLES; i++) {
+        uint16_t sample = makeSample(input, i);
+        g_window[i % MEDIAN_SIZE] = sample;
+        filterSample(sample);
+        updateFilterOutput();
+        if (getFilterOutput() != sortedMedian()) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+
+//*****************************************************************************
+// Times a filter on an input, in ns per sample added and output read.
+//*****************************************************************************
+static double timeFilter(uint8_t type, int input)
+{
+    uint32_t i;
+
+    srand(361);
+    for (i = 0; i < BENCH_SAMPLES; i++) {
+        g_input[i] = makeSample(input, i);
+    }
+
+    setFilter(type);
+    double start = hostSeconds();
+    for (i = 0; i < BENCH_SAMPLES; i++) {
+        filterSample(g_input[i]);
+        updateFilterOutput();
+        g_sink = getFilterOutput();
+    }
+    return (hostSeconds() - start) * 1e9 / BENCH_SAMPLES;
+}
+
+
+//*****************************************************************************
+// Times sorting the window afresh for every sample, as a median filter
+// would without the sorted window. Uses the input of the last timeFilter.
+//*****************************************************************************
+static double timeSort(void)
+{
+    uint32_t i;
+
+    double start = hostSeconds();
+    for (i = 0; i < BENCH_SAMPLES / 10; i++) {
+        g_window[i % MEDIAN_SIZE] = g_input[i];
+        g_sink = sortedMedian();
+    }
+    return (hostSeconds() - start) * 1e9 / (BENCH_SAMPLES / 10);
+}
+
+
+int main(void)
+{
+    uint32_t mismatches = 0;
+    int input;
+
+    srand(361);
+    for (input = 0; input < NUM_INPUTS; input++) {
+        mismatches += checkInput(input);
+    }
+
+    // A rising ramp moves each new sample the whole way along the window,
+    // but every branch goes the same way
+    double boxcar = timeFilter(FILTER_BOXCAR, INPUT_RANDOM);
+    double ramp = timeFilter(FILTER_MEDIAN, INPUT_RAMP_UP);
+    double median = timeFilter(FILTER_MEDIAN, INPUT_RANDOM);
+    double sort = timeSort();
+
+    printf("window %2u: %u samples, %u differ from the sort; ns per sample: median %.1f (ramp %.1f), "
+           "boxcar %.1f, sorting %.1f\n", MEDIAN_SIZE, NUM_INPUTS * TEST_SAMPLES, mismatches,
+           median, ramp, boxcar, sort);
+    return mismatches ? 1 : 0;
+}
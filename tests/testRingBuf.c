@@ -0,0 +1,255 @@
+// *******************************************************
+//
+// testRingBuf.c
+//
+// Host test of ringBuf.c. Checks the power of two
+// capacity, the overrun and fill counters, and then runs
+// the producer and consumer on separate threads, as the
+// ADC interrupt and the serial task do, checking every
+// entry arrives once and in order. Finishes with a
+// throughput comparison against a circBufT.h buffer.
+// Exits with 1 if any check fails.
+//
+//     testRingBuf [-n entries]
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "ringBuf.h"
+#include "circBufT.h"
+
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#define STRESS_ENTRIES 20000000     // Entries passed between the threads by default
+#define STRESS_SIZE 64              // Small, so the producer often finds it full
+#define STRESS_YIELD_MASK 0xFFF     // Each thread yields about once in this many entries
+#define BENCH_SIZE 1024
+#define BENCH_BATCH 512             // Entries written, then read, each round
+#define BENCH_ROUNDS 20000
+
+CIRCBUF_DECLARE(BenchBuf, uint16_t, BENCH_SIZE)
+CIRCBUF_DEFINE(BenchBuf, uint16_t, BENCH_SIZE)
+
+
+//*****************************************************************************
+// Globals to module
+//*****************************************************************************
+static int g_failures = 0;
+static uint16_t g_stressStorage[STRESS_SIZE];
+static ringBuf_t g_stress;
+static uint32_t g_stressEntries = STRESS_ENTRIES;
+static uint32_t g_producerRetries = 0;
+
+
+//*****************************************************************************
+// Counts and reports a failed check.
+//*****************************************************************************
+#define CHECK(condition) \
+    do { if (!(condition)) { printf("FAILED line %d: %s\n", __LINE__, #condition); g_failures++; } } while (0)
+
+
+static double hostSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+//*****************************************************************************
+// Checks the buffer on one thread: capacity, ordering, full and empty.
+//*****************************************************************************
+static void testSingleThread(void)
+{
+    uint16_t storage[8];
+    ringBuf_t buffer;
+    uint16_t entry = 0;
+    uint16_t i;
+
+    CHECK(!initRingBuf(&buffer, storage, 0));
+    CHECK(!initRingBuf(&buffer, storage, 6));
+    CHECK(initRingBuf(&buffer, storage, 8));
+    CHECK(!readRingBuf(&buffer, &entry));
+
+    // Fill it, then one more is dropped and counted
+    for (i = 0; i < 8; i++) {
+        CHECK(writeRingBuf(&buffer, 100 + i));
+    }
+    CHECK(!writeRingBuf(&buffer, 999));
+    CHECK(getRingBufFill(&buffer) == 8);
+    CHECK(getRingBufOverruns(&buffer) == 1);
+    CHECK(getRingBufMaxFill(&buffer) == 8);
+
+    // Oldest first, and the dropped entry never shows up
+    for (i = 0; i < 8; i++) {
+        CHECK(readRingBuf(&buffer, &entry) && entry == 100 + i);
+    }
+    CHECK(!readRingBuf(&buffer, &entry));
+    CHECK(getRingBufFill(&buffer) == 0);
+
+    // Keep going around, past where the masked index wraps
+    for (i = 0; i < 1000; i++) {
+        CHECK(writeRingBuf(&buffer, i));
+        CHECK(readRingBuf(&buffer, &entry) && entry == i);
+    }
+    CHECK(getRingBufMaxFill(&buffer) == 8);
+}
+
+
+//*****************************************************************************
+// Producer thread, standing in for the ADC interrupt. Writes a counting
+// sequence, trying again whenever the buffer is full.
+//*****************************************************************************
+static void* produce(void* unused)
+{
+    uint32_t i;
+    (void) unused;
+
+    for (i = 0; i < g_stressEntries; i++) {
+        while (!writeRingBuf(&g_stress, (uint16_t) i)) {
+            g_producerRetries++;
+            sched_yield();
+        }
+        if ((i & STRESS_YIELD_MASK) == 0) {
+            sched_yield();
+        }
+    }
+    return 0;
+}
+
+
+//*****************************************************************************
+// Consumer thread, standing in for the serial task. Every entry must be the
+// next in the sequence.
+//*****************************************************************************
+static void* consume(void* unused)
+{
+    uint32_t i = 0;
+    uint32_t outOfOrder = 0;
+    uint16_t entry;
+    (void) unused;
+
+    while (i < g_stressEntries) {
+        if (!readRingBuf(&g_stress, &entry)) {
+            sched_yield();
+            continue;
+        }
+        if (entry != (uint16_t) i) {
+            outOfOrder++;
+        }
+        i++;
+        if ((i & STRESS_YIELD_MASK) == 0) {
+            sched_yield();
+        }
+    }
+    return (void*) (uintptr_t) outOfOrder;
+}
+
+
+//*****************************************************************************
+// Passes g_stressEntries between two threads and checks none were lost,
+// repeated or reordered.
+//*****************************************************************************
+static void testTwoThreads(void)
+{
+    pthread_t producer, consumer;
+    void* outOfOrder;
+
+    CHECK(initRingBuf(&g_stress, g_stressStorage, STRESS_SIZE));
+    double start = hostSeconds();
+    pthread_create(&consumer, 0, consume, 0);
+    pthread_create(&producer, 0, produce, 0);
+    pthread_join(producer, 0);
+    pthread_join(consumer, &outOfOrder);
+    double seconds = hostSeconds() - start;
+
+    CHECK(outOfOrder == 0);
+    CHECK(getRingBufFill(&g_stress) == 0);
+    CHECK(getRingBufOverruns(&g_stress) == g_producerRetries);
+    CHECK(getRingBufMaxFill(&g_stress) <= STRESS_SIZE);
+    printf("two threads: %u entries in %.2f s, %u found it full, max fill %u/%u, %lu out of order\n",
+           g_stressEntries, seconds, getRingBufOverruns(&g_stress), getRingBufMaxFill(&g_stress),
+           STRESS_SIZE, (unsigned long) (uintptr_t) outOfOrder);
+}
+
+
+//*****************************************************************************
+// Times writing then reading a batch, round after round, through each kind
+// of buffer on one thread. The circBufT.h buffer has no fill count, so it
+// is read back blind.
+//*****************************************************************************
+static void benchmark(void)
+{
+    static uint16_t storage[BENCH_SIZE];
+    static BenchBuf_t circ;
+    ringBuf_t ring;
+    uint32_t round, i;
+    uint32_t check = 0;
+    uint16_t entry;
+
+    initRingBuf(&ring, storage, BENCH_SIZE);
+    double start = hostSeconds();
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        for (i = 0; i < BENCH_BATCH; i++) {
+            writeRingBuf(&ring, (uint16_t) i);
+        }
+        while (readRingBuf(&ring, &entry)) {
+            check += entry;
+        }
+    }
+    double ringSeconds = hostSeconds() - start;
+
+    initBenchBuf(&circ);
+    start = hostSeconds();
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        for (i = 0; i < BENCH_BATCH; i++) {
+            writeBenchBuf(&circ, (uint16_t) i);
+        }
+        for (i = 0; i < BENCH_BATCH; i++) {
+            check -= readBenchBuf(&circ);
+        }
+    }
+    double circSeconds = hostSeconds() - start;
+
+    double entries = (double) BENCH_ROUNDS * BENCH_BATCH;
+    printf("throughput: ringBuf %.2f ns, circBuf %.2f ns per entry written and read\n",
+           ringSeconds * 1e9 / entries, circSeconds * 1e9 / entries);
+    CHECK(check == 0);
+}
+
+
+int main(int argc, char* argv[])
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "n:")) != -1) {
+        switch (option)
+        {
+            case 'n': g_stressEntries = strtoul(optarg, 0, 10); break;
+            default:
+                fprintf(stderr, "usage: %s [-n entries]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    testSingleThread();
+    testTwoThreads();
+    benchmark();
+
+    printf("testRingBuf: %s\n", g_failures ? "FAILED" : "ok");
+    return g_failures ? 1 : 0;
+}
@@ -14,6 +14,10 @@
 // Includes
 //*****************************************************************************
 #include "timings.h"
+#include "events.h"
+
+// Built for the board only. timingsVirtual.c stands in for this on a host.
+#ifndef TIMINGS_VIRTUAL
 
 //*****************************************************************************
 // Defines
@@ -22,13 +26,31 @@
 #define TIMING_MODE TIMER_CFG_PERIODIC
 #define TIMING_PERIPH SYSCTL_PERIPH_WTIMER5
 #define TIMING_TIMER TIMER_BOTH
-#define TIMING_MAX_64 18446744073709551615
+#define TIMING_MAX_64 0xFFFFFFFFFFFFFFFFull
+#define WAKE_BASE WTIMER4_BASE
+#define WAKE_PERIPH SYSCTL_PERIPH_WTIMER4
+#define WAKE_TIMER TIMER_A
+#define WAKE_MODE (TIMER_CFG_SPLIT_PAIR | TIMER_CFG_A_ONE_SHOT)
+#define WAKE_INT_FLAG TIMER_TIMA_TIMEOUT
+#define FOREGROUND_BASE TIMER1_BASE
+#define FOREGROUND_PERIPH SYSCTL_PERIPH_TIMER1
+#define FOREGROUND_TIMER TIMER_A
+#define FOREGROUND_MODE TIMER_CFG_PERIODIC
+#define FOREGROUND_INT INT_TIMER1A
+#define FOREGROUND_INT_FLAG TIMER_TIMA_TIMEOUT
+#define DWT_CTRL_R HWREG(0xE0001000)        // Data watchpoint and trace control
+#define DWT_CYCCNT_R HWREG(0xE0001004)      // Data watchpoint and trace cycle count
+#define DEBUG_DEMCR_R HWREG(0xE000EDFC)     // Debug exception and monitor control
+#define DWT_CTRL_CYCCNTENA 0x00000001
+#define DEBUG_DEMCR_TRCENA 0x01000000
 
 
 //*****************************************************************************
 // Globals to module
 //*****************************************************************************
-static clockRate;
+static uint32_t g_lastCycles = 0;   // Cycle count when the clock was last read
+static uint32_t g_cycleWraps = 0;   // Times the cycle count has wrapped, the top half of the clock
+static uint64_t g_sleptTicks = 0;   // Ticks spent asleep, which the cycle counter misses
 
 //*****************************************************************************
 // Sets up the timer module.
@@ -36,7 +58,11 @@ static clockRate;
 //*****************************************************************************
 void initTimer(void)
 {
-    clockRate = SysCtlClockGet();
+    // The cycle counter is the clock, the timer measures time spent asleep
+    initCycleCounter();
+    g_lastCycles = 0;
+    g_cycleWraps = 0;
+    g_sleptTicks = 0;
 
     // Timer initialisation
     SysCtlPeripheralReset(TIMING_PERIPH);
@@ -51,22 +77,57 @@ void initTimer(void)
 
 
 //*****************************************************************************
-// Gets the current time in clock ticks.
+// Reads the low 32 bits of the hardware timer, counting up. Carries on
+// counting while the processor sleeps, unlike the cycle counter.
+//*****************************************************************************
+static uint32_t getTimerTicks(void)
+{
+    // Timer counts down, so invert it to count up.
+    return ~TimerValueGet(TIMING_BASE, TIMER_A);
+}
+
+
+//*****************************************************************************
+// Gets the current time in clock ticks since initTimer, counting up. Built
+// from the cycle counter, extended to 64 bits by counting its wraps, plus the
+// time spent asleep. Interrupts are masked so that the two halves are always
+// read together. A wrap is only seen if this is called at least once every
+// 2^32 cycles awake, which the kernel does on every pass.
 //*****************************************************************************
 uint64_t getCurTime(void)
 {
-    return TimerValueGet64(TIMING_BASE);
+    bool wasMasked = IntMasterDisable();
+    uint32_t cycles = DWT_CYCCNT_R;
+    if (cycles < g_lastCycles) {
+        g_cycleWraps++;
+    }
+    g_lastCycles = cycles;
+    uint64_t time = ((((uint64_t) g_cycleWraps) << 32) | cycles) + g_sleptTicks;
+    if (!wasMasked) {
+        IntMasterEnable();
+    }
+    return time;
 }
 
 
 //*****************************************************************************
-// Returns the elapsed time since a past time.
+// Gets the low 32 bits of the current time in clock ticks, counting up.
+// Cheaper than the full 64-bit read, and differences between two values are
+// valid across a wrap, which happens every 2^32 ticks. The time asleep only
+// changes with interrupts masked, so its low half can be read on its own.
+//*****************************************************************************
+uint32_t getCurTicks(void)
+{
+    return DWT_CYCCNT_R + (uint32_t) g_sleptTicks;
+}
+
+
+//*****************************************************************************
+// Returns the elapsed time in ticks since a past time.
 //*****************************************************************************
 uint64_t getElapsedTime(uint64_t pastTime)
 {
-    // Timer counts down so calculation seems unintuative.
-    uint64_t current = getCurTime();
-    return (pastTime - current);
+    return (getCurTime() - pastTime);
 }
 
 //*****************************************************************************
@@ -74,20 +135,144 @@ uint64_t getElapsedTime(uint64_t pastTime)
 //*****************************************************************************
 uint64_t getTimeDiff(uint64_t pastTime, uint64_t current)
 {
-    // Timer counts down so calculation seems unintuative.
-    return (pastTime - current);
+    return (current - pastTime);
+}
+
+
+//*****************************************************************************
+// Returns the number of clock ticks in one period of the given rate in HZ.
+//*****************************************************************************
+uint64_t getTicksPerPeriod(uint32_t rate)
+{
+    return SYSTEM_CLOCK_HZ / rate;
+}
+
+
+//*****************************************************************************
+// Sets up the one-shot timer used to wake the processor from idle sleep.
+//*****************************************************************************
+void initWakeTimer(void)
+{
+    SysCtlPeripheralReset(WAKE_PERIPH);
+    SysCtlPeripheralEnable(WAKE_PERIPH);
+
+    TimerDisable(WAKE_BASE, WAKE_TIMER);
+    TimerConfigure(WAKE_BASE, WAKE_MODE);
+    TimerIntRegister(WAKE_BASE, WAKE_TIMER, wakeTimerIntHandler);
+    TimerIntEnable(WAKE_BASE, WAKE_INT_FLAG);
+}
+
+
+//*****************************************************************************
+// Interrupt handler for the wake timer. Waking the processor is all it is
+// needed for, so it only has to clear the interrupt.
+//*****************************************************************************
+void wakeTimerIntHandler(void)
+{
+    TimerIntClear(WAKE_BASE, WAKE_INT_FLAG);
+}
+
+
+//*****************************************************************************
+// Sleeps the processor until the given number of ticks has passed, or until
+// any other interrupt occurs. Interrupts are masked while checking for
+// events, so that one which fires just before the WFI still wakes the
+// processor. It is then handled once interrupts are unmasked again. Returns
+// the number of ticks slept, which is 0 if an event was already waiting.
+//*****************************************************************************
+uint32_t sleepFor(uint32_t ticks)
+{
+    uint32_t slept = 0;
+    IntMasterDisable();
+    if (!anyEventPending()) {
+        uint32_t sleepStart = getTimerTicks();
+        uint32_t cycleStart = DWT_CYCCNT_R;
+        TimerLoadSet(WAKE_BASE, WAKE_TIMER, ticks);
+        TimerEnable(WAKE_BASE, WAKE_TIMER);
+        SysCtlSleep();
+        TimerDisable(WAKE_BASE, WAKE_TIMER);
+        slept = getTimerTicks() - sleepStart;
+
+        // The cycle counter stops while the core clock is gated, so add the
+        // time it missed on to the clock.
+        uint32_t cycles = DWT_CYCCNT_R - cycleStart;
+        if (slept > cycles) {
+            g_sleptTicks += slept - cycles;
+        }
+    }
+    IntMasterEnable();
+    return slept;
+}
+
+
+//*****************************************************************************
+// Sets up a periodic timer interrupt at the given rate in HZ, used to run a
+// foreground task at a fixed period regardless of the background load.
+//*****************************************************************************
+void initForegroundTimer(uint32_t rate, uint8_t priority, void (*handler)(void))
+{
+    SysCtlPeripheralReset(FOREGROUND_PERIPH);
+    SysCtlPeripheralEnable(FOREGROUND_PERIPH);
+
+    TimerDisable(FOREGROUND_BASE, FOREGROUND_TIMER);
+    TimerConfigure(FOREGROUND_BASE, FOREGROUND_MODE);
+    TimerLoadSet(FOREGROUND_BASE, FOREGROUND_TIMER, (SYSTEM_CLOCK_HZ / rate) - 1);
+    TimerIntRegister(FOREGROUND_BASE, FOREGROUND_TIMER, handler);
+    IntPrioritySet(FOREGROUND_INT, priority);
+    TimerIntEnable(FOREGROUND_BASE, FOREGROUND_INT_FLAG);
+    TimerEnable(FOREGROUND_BASE, FOREGROUND_TIMER);
+}
+
+
+//*****************************************************************************
+// Changes the rate in HZ of the foreground timer. Takes effect from the next
+// time the timer expires.
+//*****************************************************************************
+void setForegroundTimerRate(uint32_t rate)
+{
+    TimerLoadSet(FOREGROUND_BASE, FOREGROUND_TIMER, (SYSTEM_CLOCK_HZ / rate) - 1);
 }
 
 
 //*****************************************************************************
-// Schedules a function at a desired rate in HZ.
-// If it is time for the function to run, true value will be returned.
+// Clears the foreground timer interrupt.
 //*****************************************************************************
-bool shouldBeRun(uint64_t lastRun, uint32_t rate)
+void clearForegroundTimer(void)
 {
-    // If is time to run it
-    return (getElapsedTime(lastRun) > (clockRate / rate));
+    TimerIntClear(FOREGROUND_BASE, FOREGROUND_INT_FLAG);
 }
 
 
+//*****************************************************************************
+// Returns the ticks since the foreground timer last expired. Called from the
+// foreground interrupt this is the interrupt latency.
+//*****************************************************************************
+uint32_t getForegroundTimerLateness(void)
+{
+    // Timer counts down from the load value after it expires.
+    return TimerLoadGet(FOREGROUND_BASE, FOREGROUND_TIMER) - TimerValueGet(FOREGROUND_BASE, FOREGROUND_TIMER);
+}
+
+
+//*****************************************************************************
+// Enables the Cortex-M4 DWT cycle counter, used for cheap timing measurements.
+// Called by initTimer, as the clock is built on it.
+//*****************************************************************************
+void initCycleCounter(void)
+{
+    DEBUG_DEMCR_R |= DEBUG_DEMCR_TRCENA;
+    DWT_CYCCNT_R = 0;
+    DWT_CTRL_R |= DWT_CTRL_CYCCNTENA;
+}
+
+
+//*****************************************************************************
+// Gets the current processor cycle count. Counts up and wraps at 32 bits, so
+// differences between two counts are valid across a wrap.
+//*****************************************************************************
+uint32_t getCycleCount(void)
+{
+    return DWT_CYCCNT_R;
+}
 
+#endif /* TIMINGS_VIRTUAL */
@@ -12,6 +12,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#ifndef TIMINGS_VIRTUAL
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
 #include "driverlib/gpio.h"
@@ -20,6 +21,37 @@
 #include "driverlib/pin_map.h"
 #include "inc/tm4c123gh6pm.h"
 #include "driverlib/timer.h"
+#include "driverlib/interrupt.h"
+#endif
+
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#define CLOCK_80MHZ 0                       // 1 to run the system clock at 80 MHz, 0 for 20 MHz
+
+// Every other timing constant is worked out from the system clock rate, so
+// changing it keeps the behaviour of the helicopter the same.
+#if CLOCK_80MHZ
+#define SYSTEM_CLOCK_HZ 80000000
+#define SYSTEM_CLOCK_DIV SYSCTL_SYSDIV_2_5      // 400 MHz PLL / 2 / 2.5
+#else
+#define SYSTEM_CLOCK_HZ 20000000
+#define SYSTEM_CLOCK_DIV SYSCTL_SYSDIV_10       // 400 MHz PLL / 2 / 10
+#endif
+#define TIMING_MAX_SLEEP_TICKS 0xFFFFFFFF   // Longest delay the wake timer can be armed for
+#define TICKS_PER_MS (SYSTEM_CLOCK_HZ / 1000)
+#define TICKS_PER_US (SYSTEM_CLOCK_HZ / 1000000)
+
+
+//*****************************************************************************
+// Macros for converting between clock ticks and real time. Worked out from
+// the system clock at compile time, so only a multiply or divide is left.
+//*****************************************************************************
+#define TICKS_TO_MS(ticks) ((ticks) / TICKS_PER_MS)
+#define TICKS_TO_US(ticks) ((ticks) / TICKS_PER_US)
+#define MS_TO_TICKS(ms) ((ms) * TICKS_PER_MS)
+#define US_TO_TICKS(us) ((us) * TICKS_PER_US)
 
 
 //*****************************************************************************
@@ -27,9 +59,24 @@
 //*****************************************************************************
 void initTimer(void);
 uint64_t getCurTime(void);
+uint32_t getCurTicks(void);
 uint64_t getElapsedTime(uint64_t pastTime);
-bool shouldBeRun(uint64_t lastRun, uint32_t rate);
 uint64_t getTimeDiff(uint64_t pastTime, uint64_t current);
+uint64_t getTicksPerPeriod(uint32_t rate);
+void initWakeTimer(void);
+void wakeTimerIntHandler(void);
+uint32_t sleepFor(uint32_t ticks);
+void initForegroundTimer(uint32_t rate, uint8_t priority, void (*handler)(void));
+void setForegroundTimerRate(uint32_t rate);
+void clearForegroundTimer(void);
+uint32_t getForegroundTimerLateness(void);
+void initCycleCounter(void);
+uint32_t getCycleCount(void);
+#ifdef TIMINGS_VIRTUAL
+void advanceVirtualTime(uint32_t ticks);
+void setVirtualInterrupt(uint32_t period, void (*handler)(void));
+void setVirtualInterruptJitter(uint32_t maxTicks);
+#endif
 
 
 #endif /* TIMINGS_H_ */
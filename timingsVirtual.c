@@ -0,0 +1,295 @@
+// *******************************************************
+//
+// timingsVirtual.c
+//
+// Stand-in for the timing functions when built on a host
+// with TIMINGS_VIRTUAL defined. Time only moves when
+// advanceVirtualTime is called, so a process can be given
+// a synthetic cost by advancing time from its handler,
+// and the kernel can be run far faster than real time.
+// Besides the foreground timer, one peripheral interrupt
+// can be modelled, and every interrupt can be entered a
+// pseudo-random number of ticks late, as masked sections
+// and other interrupts would delay it on the board.
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include "timings.h"
+#include "events.h"
+
+#ifdef TIMINGS_VIRTUAL
+
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#define VIRTUAL_FOREGROUND 0        // Interrupt of the foreground timer
+#define VIRTUAL_PERIPHERAL 1        // Interrupt set with setVirtualInterrupt
+#define VIRTUAL_INTERRUPTS 2
+
+
+//*****************************************************************************
+// Types
+//*****************************************************************************
+typedef struct {
+    void (*handler)(void);
+    uint32_t period;        // Ticks between expiries, 0 while stopped
+    uint64_t due;           // Next time it expires
+    uint64_t expired;       // Last time it expired
+} VirtualInterrupt;
+
+
+//*****************************************************************************
+// Globals to module
+//*****************************************************************************
+static uint64_t g_virtualTime = 0;          // Ticks since start, counting up
+static VirtualInterrupt g_interrupts[VIRTUAL_INTERRUPTS];
+static bool g_inInterrupt = false;          // Set while an interrupt handler runs
+static uint32_t g_entryJitter = 0;          // Most ticks an interrupt is entered late by
+static uint32_t g_jitterState = 1;          // State of the entry delay generator
+
+
+//*****************************************************************************
+// Starts virtual time from zero.
+//*****************************************************************************
+void initTimer(void)
+{
+    g_virtualTime = 0;
+}
+
+
+//*****************************************************************************
+// Gets the current time in clock ticks since initTimer, counting up.
+//*****************************************************************************
+uint64_t getCurTime(void)
+{
+    return g_virtualTime;
+}
+
+
+//*****************************************************************************
+// Gets the low 32 bits of the current time in clock ticks, counting up.
+//*****************************************************************************
+uint32_t getCurTicks(void)
+{
+    return (uint32_t)g_virtualTime;
+}
+
+
+//*****************************************************************************
+// Returns the elapsed time in ticks since a past time.
+//*****************************************************************************
+uint64_t getElapsedTime(uint64_t pastTime)
+{
+    return (getCurTime() - pastTime);
+}
+
+
+//*****************************************************************************
+// Returns the difference (in ticks) between two reference times.
+//*****************************************************************************
+uint64_t getTimeDiff(uint64_t pastTime, uint64_t current)
+{
+    return (current - pastTime);
+}
+
+
+//*****************************************************************************
+// Returns the number of clock ticks in one period of the given rate in HZ.
+//*****************************************************************************
+uint64_t getTicksPerPeriod(uint32_t rate)
+{
+    return SYSTEM_CLOCK_HZ / rate;
+}
+
+
+//*****************************************************************************
+// Returns the running interrupt that expires first, or 0 if there is none.
+//*****************************************************************************
+static VirtualInterrupt* nextInterrupt(void)
+{
+    VirtualInterrupt* next = 0;
+    uint8_t i;
+
+    for (i = 0; i < VIRTUAL_INTERRUPTS; i++) {
+        if (g_interrupts[i].period != 0 && (next == 0 || g_interrupts[i].due < next->due)) {
+            next = &g_interrupts[i];
+        }
+    }
+    return next;
+}
+
+
+//*****************************************************************************
+// Returns the ticks the next interrupt is entered late by, from 0 up to
+// g_entryJitter. A fixed xorshift sequence, so every run is the same.
+//*****************************************************************************
+static uint32_t entryDelay(void)
+{
+    if (g_entryJitter == 0) {
+        return 0;
+    }
+    g_jitterState ^= g_jitterState << 13;
+    g_jitterState ^= g_jitterState >> 17;
+    g_jitterState ^= g_jitterState << 5;
+    return g_jitterState % (g_entryJitter + 1);
+}
+
+
+//*****************************************************************************
+// Moves virtual time on by the given number of ticks, running the interrupt
+// handlers at each expiry on the way, in the order they expire. Called from
+// a handler, the time is added straight away and any expiries it passes are
+// run late once the handler returns, as they would be on the board.
+//*****************************************************************************
+void advanceVirtualTime(uint32_t ticks)
+{
+    uint64_t target = g_virtualTime + ticks;
+    VirtualInterrupt* next;
+
+    while (!g_inInterrupt && (next = nextInterrupt()) != 0 && next->due <= target) {
+        uint64_t entry = next->due + entryDelay();
+        if (g_virtualTime < entry) {
+            g_virtualTime = entry;
+        }
+        next->expired = next->due;
+        next->due += next->period;
+        g_inInterrupt = true;
+        next->handler();
+        g_inInterrupt = false;
+    }
+
+    if (g_virtualTime < target) {
+        g_virtualTime = target;
+    }
+}
+
+
+//*****************************************************************************
+// Nothing to set up, sleeping just moves time on.
+//*****************************************************************************
+void initWakeTimer(void)
+{
+}
+
+
+//*****************************************************************************
+// Only here to match the board build.
+//*****************************************************************************
+void wakeTimerIntHandler(void)
+{
+}
+
+
+//*****************************************************************************
+// Moves time on by the given number of ticks, or only up to the next
+// interrupt, as that would wake the board. Does not sleep if an event is
+// waiting. Returns the ticks slept.
+//*****************************************************************************
+uint32_t sleepFor(uint32_t ticks)
+{
+    uint64_t start = g_virtualTime;
+    uint64_t wake = start + ticks;
+    VirtualInterrupt* next = nextInterrupt();
+
+    if (anyEventPending()) {
+        return 0;
+    }
+    if (next != 0 && next->due > start && next->due < wake) {
+        wake = next->due;
+    }
+    advanceVirtualTime((uint32_t)(wake - start));
+    return (uint32_t)(wake - start);
+}
+
+
+//*****************************************************************************
+// Sets the foreground handler to run every period of the given rate in HZ.
+//*****************************************************************************
+void initForegroundTimer(uint32_t rate, uint8_t priority, void (*handler)(void))
+{
+    VirtualInterrupt* timer = &g_interrupts[VIRTUAL_FOREGROUND];
+
+    (void) priority;    // Handlers never preempt each other, so nothing to order
+    timer->handler = handler;
+    timer->period = SYSTEM_CLOCK_HZ / rate;
+    timer->due = g_virtualTime + timer->period;
+}
+
+
+//*****************************************************************************
+// Changes the rate in HZ of the foreground timer, from the next expiry.
+//*****************************************************************************
+void setForegroundTimerRate(uint32_t rate)
+{
+    g_interrupts[VIRTUAL_FOREGROUND].period = SYSTEM_CLOCK_HZ / rate;
+}
+
+
+//*****************************************************************************
+// Nothing to clear.
+//*****************************************************************************
+void clearForegroundTimer(void)
+{
+}
+
+
+//*****************************************************************************
+// Returns the ticks since the foreground timer last expired.
+//*****************************************************************************
+uint32_t getForegroundTimerLateness(void)
+{
+    return (uint32_t)(g_virtualTime - g_interrupts[VIRTUAL_FOREGROUND].expired);
+}
+
+
+//*****************************************************************************
+// Runs the handler every period ticks from now, as a peripheral's interrupt
+// would, such as the ADC's at the end of each block. A period of 0 stops it.
+//*****************************************************************************
+void setVirtualInterrupt(uint32_t period, void (*handler)(void))
+{
+    VirtualInterrupt* peripheral = &g_interrupts[VIRTUAL_PERIPHERAL];
+
+    peripheral->handler = handler;
+    peripheral->period = period;
+    peripheral->due = g_virtualTime + period;
+}
+
+
+//*****************************************************************************
+// Has every interrupt entered up to the given number of ticks after it
+// expires, spread pseudo-randomly, as masked sections and other interrupts
+// delay it on the board. 0, the default, enters them on time.
+//*****************************************************************************
+void setVirtualInterruptJitter(uint32_t maxTicks)
+{
+    g_entryJitter = maxTicks;
+}
+
+
+//*****************************************************************************
+// Nothing to set up, the cycle count is taken from virtual time.
+//*****************************************************************************
+void initCycleCounter(void)
+{
+}
+
+
+//*****************************************************************************
+// Gets the current cycle count. The processor is clocked at the tick rate.
+//*****************************************************************************
+uint32_t getCycleCount(void)
+{
+    return (uint32_t)g_virtualTime;
+}
+
+
+#endif /* TIMINGS_VIRTUAL */
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+# *******************************************************
+#
+# traceToChrome.py
+#
+# Converts a trace sent over serial by the helicopter into
+# Chrome trace JSON, which can be opened in chrome://tracing
+# or ui.perfetto.dev. Send 't' over serial to ask for a
+# trace, save everything received to a file, then run
+#
+#     python3 traceToChrome.py capture.txt > trace.json
+#
+# Everything is put on one thread, so an interrupt shows
+# nested inside the task or interrupt it preempted.
+#
+# Tom Rizzi, Euan Robinson, Satwik Meravanage
+# Last modified: 21 May 2021
+#
+# *******************************************************
+
+import json
+import sys
+
+# Must match traceIds in trace.h. Processes are named by the trace itself.
+FIXED_NAMES = {0: "ADC", 1: "Yaw", 2: "sleep"}
+PHASES = {"B": "B", "E": "E", "I": "i"}
+
+
+def readTrace(lines):
+    """Returns the tick rate, id names and events of the last trace in the lines."""
+    rate = None
+    names = dict(FIXED_NAMES)
+    events = []
+    inTrace = False
+    for line in lines:
+        fields = line.split()
+        if not fields:
+            continue
+        if fields[0] == "TRACE" and len(fields) == 3:
+            rate = int(fields[1])
+            names = dict(FIXED_NAMES)
+            events = []
+            inTrace = True
+        elif not inTrace:
+            continue
+        elif fields[0] == "END":
+            inTrace = False
+        elif fields[0] == "N" and len(fields) == 3:
+            names[int(fields[1])] = fields[2]
+        elif fields[0] in PHASES and len(fields) == 3:
+            events.append((fields[0], int(fields[1]), int(fields[2])))
+    if rate is None:
+        raise ValueError("no trace found")
+    return rate, names, events
+
+
+def toChrome(rate, names, events):
+    """Converts events to Chrome trace events, with times in microseconds."""
+    traceEvents = []
+    elapsed = 0
+    last = None
+    for kind, traceId, ticks in events:
+        # Tick counts are 32 bits, so undo any wrap between events
+        if last is not None:
+            elapsed += (ticks - last) & 0xFFFFFFFF
+        last = ticks
+        event = {
+            "name": names.get(traceId, "id %d" % traceId),
+            "ph": PHASES[kind],
+            "ts": elapsed * 1e6 / rate,
+            "pid": 0,
+            "tid": 0,
+        }
+        if kind == "I":
+            event["s"] = "t"
+        traceEvents.append(event)
+    return {"traceEvents": traceEvents, "displayTimeUnit": "ns"}
+
+
+def main():
+    if len(sys.argv) > 1:
+        with open(sys.argv[1], errors="replace") as capture:
+            lines = capture.readlines()
+    else:
+        lines = sys.stdin.readlines()
+    rate, names, events = readTrace(lines)
+    json.dump(toChrome(rate, names, events), sys.stdout, indent=1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,81 @@
+// *******************************************************
+//
+// trace.c
+//
+// Records begin, end and instant events from interrupts
+// and kernel processes into a ring buffer in RAM, keeping
+// the most recent TRACE_BUFFER_SIZE. The buffer is paused
+// while it is read out, so the copy sent is consistent.
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+
+//*****************************************************************************
+// Includes
+//*****************************************************************************
+#include "trace.h"
+#include "timings.h"
+
+
+//*****************************************************************************
+// Globals to module
+//*****************************************************************************
+static TraceEntry g_trace[TRACE_BUFFER_SIZE];
+static uint32_t g_traceHead = 0;        // Number of events ever recorded
+static volatile bool g_tracePaused = false;
+
+
+//*****************************************************************************
+// Records a trace event with the current time. Safe to call from an
+// interrupt, which are masked only while the entry is written.
+//*****************************************************************************
+void traceRecord(uint8_t id, uint8_t kind)
+{
+    if (g_tracePaused) {
+        return;
+    }
+
+    bool wasMasked = IntMasterDisable();
+    TraceEntry* entry = &g_trace[g_traceHead & (TRACE_BUFFER_SIZE - 1)];
+    entry->time = getCurTicks();
+    entry->id = id;
+    entry->kind = kind;
+    g_traceHead++;
+    if (!wasMasked) {
+        IntMasterEnable();
+    }
+}
+
+
+//*****************************************************************************
+// Stops or restarts recording. Unpausing starts a fresh trace.
+//*****************************************************************************
+void pauseTrace(bool paused)
+{
+    if (!paused) {
+        g_traceHead = 0;
+    }
+    g_tracePaused = paused;
+}
+
+
+//*****************************************************************************
+// Returns the number of events held in the buffer.
+//*****************************************************************************
+uint32_t getTraceCount(void)
+{
+    return (g_traceHead < TRACE_BUFFER_SIZE) ? g_traceHead : TRACE_BUFFER_SIZE;
+}
+
+
+//*****************************************************************************
+// Returns the event at the given index, where 0 is the oldest held.
+//*****************************************************************************
+TraceEntry getTraceEntry(uint32_t index)
+{
+    uint32_t oldest = g_traceHead - getTraceCount();
+    return g_trace[(oldest + index) & (TRACE_BUFFER_SIZE - 1)];
+}
@@ -0,0 +1,76 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+// *******************************************************
+//
+// trace.h
+//
+// Tom Rizzi, Euan Robinson, Satwik Meravanage
+// Last modified: 21 May 2021
+//
+// *******************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//*****************************************************************************
+// Constants
+//*****************************************************************************
+#define TRACE_ENABLED 1         // 1 to record trace events, 0 to compile them out
+#define TRACE_BUFFER_SIZE 512   // Entries kept, must be a power of two
+#define TRACE_REQUEST_CHAR 't'  // Sent over serial to ask for the trace
+
+//*****************************************************************************
+// Enumeration of what can be traced. Kernel processes are traced as
+// TRACE_ID_TASK plus their index in the process table.
+//*****************************************************************************
+enum traceIds {
+    TRACE_ID_ADC = 0,
+    TRACE_ID_YAW,
+    TRACE_ID_SLEEP,
+    TRACE_ID_TASK
+};
+
+//*****************************************************************************
+// Enumeration of the kinds of trace event
+//*****************************************************************************
+enum traceKinds {
+    TRACE_KIND_BEGIN = 'B',
+    TRACE_KIND_END = 'E',
+    TRACE_KIND_INSTANT = 'I'
+};
+
+//*****************************************************************************
+// Structure to hold one trace event
+//*****************************************************************************
+typedef struct TraceEntry {
+    uint32_t time;          // Tick the event happened, from getCurTicks.
+    uint8_t id;             // What it happened to, from traceIds.
+    uint8_t kind;           // Begin, end or instant, from traceKinds.
+} TraceEntry;
+
+//*****************************************************************************
+// Macros for recording trace events, so they cost nothing when disabled.
+// Not recorded on a host, where there are no interrupts to trace.
+//*****************************************************************************
+#if TRACE_ENABLED && !defined(TIMINGS_VIRTUAL)
+#define TRACE_BEGIN(id) traceRecord((id), TRACE_KIND_BEGIN)
+#define TRACE_END(id) traceRecord((id), TRACE_KIND_END)
+#define TRACE_INSTANT(id) traceRecord((id), TRACE_KIND_INSTANT)
+#else
+#define TRACE_BEGIN(id)
+#define TRACE_END(id)
+#define TRACE_INSTANT(id)
+#endif
+
+
+//*****************************************************************************
+// Function declarations
+//*****************************************************************************
+void traceRecord(uint8_t id, uint8_t kind);
+void pauseTrace(bool paused);
+uint32_t getTraceCount(void);
+TraceEntry getTraceEntry(uint32_t index);
+
+
+#endif /* TRACE_H_ */
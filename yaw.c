@@ -24,6 +24,8 @@
 #include "driverlib/gpio.h"
 #include "driverlib/interrupt.h"
 #include "timings.h"
+#include "events.h"
+#include "trace.h"
 
 
 //*****************************************************************************
@@ -60,8 +62,10 @@ static uint64_t yawRefTimeStart = 0;
 //*****************************************************************************
 void YawIntHandler(void)
 {
+    TRACE_BEGIN(TRACE_ID_YAW);
     GPIOIntClear(YAW_PORT_BASE, YAW_INT_PIN_A | YAW_INT_PIN_B | GPIO_INT_PIN_2 | GPIO_INT_PIN_3);
     updateQuadEncoder(GPIOPinRead(YAW_PORT_BASE, YAW_PINS));
+    TRACE_END(TRACE_ID_YAW);
 }
 
 
@@ -75,6 +79,7 @@ void yawRefIntHandler(void)
     if (!yawRefFound) {
         referenceYaw = getYaw();
         yawRefFound = true;
+        postEvent(EVENT_YAW_REF_FOUND);
     }
 }
 
@@ -165,7 +170,7 @@ uint32_t findReferenceYaw(uint32_t startYaw) // might need to pass in yaw by ref
             yawRefTimeStart = getCurTime();
         }
 
-        outputYaw = (startYaw + ((YAW_SEARCH_RATE * getElapsedTime(yawRefTimeStart)) / SysCtlClockGet())) % YAW_ANGLE_MAX;
+        outputYaw = (startYaw + ((YAW_SEARCH_RATE * getElapsedTime(yawRefTimeStart)) / SYSTEM_CLOCK_HZ)) % YAW_ANGLE_MAX;
     }
 
     return outputYaw;